@@ -23,10 +23,13 @@
 //
 #include "ansi_logic.h"
 
+#include "simd_scan.h"
+
 #include <unicode/uchar.h>
 
 #include <algorithm>
 #include <cctype>
+#include <chrono>
 #include <iostream>
 
 const RgbColor AnsiLogic::normal_colors[8] = {
@@ -54,23 +57,437 @@ const RgbColor AnsiLogic::bright_colors[8] = {
 AnsiLogic::AnsiLogic(int cols, int rows)
     : term_cols(cols), term_rows(rows), state(AnsiState::NORMAL)
 {
-    text_buffer.resize(term_rows, std::vector<Char>(term_cols, { L' ', current_attr }));
+    text_buffer.resize(term_rows, Line(term_cols, { L' ', current_attr }, &arena));
+    wrapped.resize(term_rows);
+    reset_margins();
+    resize_tab_stops();
 }
 
+//
+// Resize the screen. New width needs reflow of text. New height keeps
+// the text anchored at the bottom: rows above the cursor scroll into history
+// when the screen gets shorter, and come back from it when it gets taller.
+// Soft-wrap flags move with their rows.
+//
 void AnsiLogic::resize(int new_cols, int new_rows)
 {
-    term_cols = new_cols;
+    if (new_cols != term_cols) {
+        reflow(new_cols, new_rows);
+        return;
+    }
+    int row = cursor.row;
+    for (int n = row + 1 - new_rows; n > 0; --n) {
+        scroll_up();
+        row--;
+    }
+    int restored = 0;
+    if (new_rows > term_rows && get_history_size() > 0) {
+        finish_reflow();
+        unwrap_history();
+        restored = std::min(new_rows - term_rows, get_history_size());
+        text_buffer.insert(text_buffer.begin(), std::make_move_iterator(history.end() - restored),
+                           std::make_move_iterator(history.end()));
+        wrapped.insert(wrapped.begin(), history_wrapped.end() - restored, history_wrapped.end());
+        history.erase(history.end() - restored, history.end());
+        history_wrapped.erase(history_wrapped.end() - restored, history_wrapped.end());
+        lines_scrolled -= restored;
+    }
     term_rows = new_rows;
-    text_buffer.resize(term_rows, std::vector<Char>(term_cols, { L' ', current_attr }));
+    text_buffer.resize(term_rows, Line(term_cols, { L' ', current_attr }, &arena));
     for (auto &line : text_buffer) {
         line.resize(term_cols, { L' ', current_attr });
     }
-    cursor.row = std::min(cursor.row, term_rows - 1);
+    wrapped.resize(term_rows);
+    wrapped.back() = false;
+    cursor.row = std::min(row + restored, term_rows - 1);
     cursor.col = std::min(cursor.col, term_cols - 1);
+    reset_margins();
+}
+
+//
+// Release memory not needed for current screen size.
+// Pool keeps freed blocks for reuse, so all data is copied out,
+// the arena is returned to the system, and data is copied back compactly.
+//
+void AnsiLogic::trim_memory()
+{
+    finish_reflow();
+    unwrap_history();
+
+    std::vector<std::vector<Char>> saved;
+    saved.reserve(text_buffer.size() + history.size());
+    for (int i = 0; i < get_history_size(); ++i) {
+        const auto &line = get_history_line(i);
+        saved.emplace_back(line.begin(), line.end());
+    }
+    for (const auto &line : text_buffer) {
+        saved.emplace_back(line.begin(), line.end());
+    }
+    std::string saved_seq(ansi_seq);
+    std::vector<ShellMark> saved_marks(shell_marks.begin(), shell_marks.end());
+
+    // Every container on the arena must let go of its buffers before release,
+    // including empty ones which keep capacity from an earlier reflow.
+    text_buffer    = std::pmr::vector<Line>(&arena);
+    history        = std::pmr::vector<Line>(&arena);
+    ansi_seq       = std::pmr::string(&arena);
+    shell_marks    = std::pmr::vector<ShellMark>(&arena);
+    reflow_source  = std::pmr::vector<Line>(&arena);
+    reflow_history = std::pmr::vector<Line>(&arena);
+    reflow_marks   = std::pmr::vector<ShellMark>(&arena);
+    arena.reset();
+
+    size_t history_size = saved.size() - term_rows;
+    history.reserve(history_size);
+    for (size_t i = 0; i < history_size; ++i) {
+        history.emplace_back(saved[i].begin(), saved[i].end());
+    }
+    history_first = 0;
+    text_buffer.reserve(term_rows);
+    for (size_t i = history_size; i < saved.size(); ++i) {
+        text_buffer.emplace_back(saved[i].begin(), saved[i].end());
+    }
+    ansi_seq = saved_seq;
+    shell_marks.assign(saved_marks.begin(), saved_marks.end());
+}
+
+int AnsiLogic::get_history_size() const
+{
+    if (reflow_job.valid()) {
+        // Rows of the head are counted when it is laid out.
+        reflow_job.wait();
+    }
+    return reflow_history.size() + history.size();
+}
+
+const Line &AnsiLogic::get_history_line(int index) const
+{
+    if (reflow_job.valid()) {
+        // Reflowed rows come first; wait until they are ready.
+        reflow_job.wait();
+        if (index < static_cast<int>(reflow_history.size()))
+            return reflow_history[index];
+        index -= reflow_history.size();
+    }
+    return history[(history_first + index) % history.size()];
+}
+
+//
+// Change maximum number of lines in scrollback history.
+// Oldest lines are discarded when needed.
+//
+void AnsiLogic::set_history_limit(int lines)
+{
+    lines = std::max(lines, 0);
+    finish_reflow();
+    unwrap_history();
+    if (get_history_size() > lines) {
+        history_wrapped.erase(history_wrapped.begin(), history_wrapped.end() - lines);
+        history.erase(history.begin(), history.end() - lines);
+    }
+    history_limit = lines;
+}
+
+//
+// Discard oldest lines of history to release at least given number of bytes.
+// Return number of bytes actually released.
+//
+size_t AnsiLogic::drop_history(size_t bytes)
+{
+    finish_reflow();
+    size_t before = memory_in_use();
+    size_t freed  = 0;
+    int count     = 0;
+    while (count < get_history_size() && freed < bytes) {
+        freed += get_history_line(count).capacity() * sizeof(Char);
+        count++;
+    }
+    unwrap_history();
+    history.erase(history.begin(), history.begin() + count);
+    history_wrapped.erase(history_wrapped.begin(), history_wrapped.begin() + count);
+    return before - memory_in_use();
+}
+
+//
+// Put history lines in order, so that the oldest one is first.
+//
+void AnsiLogic::unwrap_history()
+{
+    std::rotate(history.begin(), history.begin() + history_first, history.end());
+    std::rotate(history_wrapped.begin(), history_wrapped.begin() + history_first,
+                history_wrapped.end());
+    history_first = 0;
+}
+
+//
+// Rewrap text for a new width: rows of every logical line are joined
+// and split again. The screen shows the bottom of the text, down to the cursor.
+// Only the tail of the text is rewrapped at once: the last logical lines,
+// at least one for every new screen row. History above them, the head,
+// is laid out and built by worker threads in background: readers of history
+// wait for it.
+//
+void AnsiLogic::reflow(int new_cols, int new_rows)
+{
+    finish_reflow();
+
+    // Old rows: history, then the screen down to the cursor or the last text.
+    auto blank = [](const Char &c) { return c.ch == L' '; };
+    int used   = cursor.row + 1;
+    for (int r = term_rows - 1; r >= used; --r) {
+        if (wrapped[r] || !std::all_of(text_buffer[r].begin(), text_buffer[r].end(), blank)) {
+            used = r + 1;
+            break;
+        }
+    }
+
+    // Tail starts at a logical line of history, or takes all of it.
+    int64_t count     = history.size();
+    auto history_wrap = [&](int64_t n) { return history_wrapped[(history_first + n) % count]; };
+    int64_t split     = count;
+    int lines         = 0;
+    for (int r = 0; r < used; ++r) {
+        if (!wrapped[r] || r + 1 == used) {
+            lines++;
+        }
+    }
+    while (split > 0 && (lines < new_rows || history_wrap(split - 1))) {
+        --split;
+        if (!history_wrap(split)) {
+            lines++;
+        }
+    }
+    int64_t first      = first_line();
+    int64_t cursor_row = count - split + cursor.row;
+    std::pmr::vector<Line> tail(&arena);
+    std::vector<bool> wraps;
+    tail.reserve(count - split + used);
+    for (int64_t n = split; n < count; ++n) {
+        size_t k = (history_first + n) % count;
+        tail.push_back(std::move(history[k]));
+        wraps.push_back(history_wrapped[k]);
+    }
+    for (int r = 0; r < used; ++r) {
+        tail.push_back(std::move(text_buffer[r]));
+        wraps.push_back(wrapped[r]);
+    }
+    tail_index.build(tail, wraps, term_cols, new_cols, cursor_row, cursor.col);
+
+    // Head keeps the ring of history as is, with rows of the tail moved out.
+    std::swap(reflow_source, history);
+    std::swap(reflow_wraps, history_wrapped);
+    reflow_ring_first = history_first;
+    reflow_first      = first;
+    reflow_split      = split;
+    history_first     = 0;
+
+    // Screen shows the bottom of the text, and the cursor.
+    int64_t total = tail_index.get_new_rows();
+    int64_t new_cursor_row;
+    int new_cursor_col;
+    tail_index.map(cursor_row, cursor.col, new_cursor_row, new_cursor_col);
+    int64_t top = std::min(std::max<int64_t>(total - new_rows, 0), new_cursor_row);
+
+    int old_cols = term_cols;
+    term_cols    = new_cols;
+    term_rows    = new_rows;
+    text_buffer.resize(term_rows);
+    wrapped.assign(term_rows, false);
+    reset_margins();
+    resize_tab_stops();
+    int64_t shown = std::min<int64_t>(term_rows, total - top);
+    for (int r = 0; r < term_rows; ++r) {
+        text_buffer[r] = Line(&arena);
+        text_buffer[r].reserve(term_cols);
+        if (r < shown) {
+            wrapped[r] = tail_index.is_wrapped(top + r);
+        }
+    }
+    tail_index.fill(tail, top, top + shown, text_buffer.data());
+    for (int r = shown; r < term_rows; ++r) {
+        text_buffer[r].assign(term_cols, { L' ', current_attr });
+    }
+    cursor.row = new_cursor_row - top;
+    cursor.col = new_cursor_col;
+
+    // Rows of the tail above the screen go to history, up to its limit;
+    // the head gets the room which is left.
+    int64_t dropped = std::max<int64_t>(top - history_limit, 0);
+    reflow_room     = history_limit - (top - dropped);
+    history.resize(top - dropped);
+    history_wrapped.resize(top - dropped);
+    for (int64_t k = 0; k < top - dropped; ++k) {
+        history[k].reserve(term_cols);
+        history_wrapped[k] = tail_index.is_wrapped(dropped + k);
+    }
+    tail_index.fill(tail, dropped, top, history.data());
+
+    // Line numbers keep counting from the first line of history. Numbers
+    // are left for the head above the tail: as many as it may take in history.
+    int64_t head_rows = 0;
+    if (split > 0 && reflow_room > 0) {
+        head_rows = std::min<int64_t>(split * ((old_cols + new_cols - 1) / new_cols), reflow_room);
+    }
+    int64_t old_tail   = first + split;
+    int64_t tail_first = first + head_rows;
+    reflow_tail_first  = tail_first;
+    lines_scrolled     = tail_first + top;
+
+    // Marks and images of the head are put aside until it is laid out.
+    // Marks of lines dropped from history are not in the text to reflow.
+    auto by_line   = [](const ShellMark &m, int64_t line) { return m.line < line; };
+    auto tail_mark = std::lower_bound(shell_marks.begin(), shell_marks.end(), old_tail, by_line);
+    if (head_rows > 0) {
+        reflow_marks.assign(std::lower_bound(shell_marks.begin(), tail_mark, first, by_line),
+                            tail_mark);
+    }
+    shell_marks.erase(shell_marks.begin(), tail_mark);
+    for (auto &mark : shell_marks) {
+        int64_t row;
+        tail_index.map(mark.line - old_tail, mark.col, row, mark.col);
+        mark.line = tail_first + row;
+    }
+    shell_marks.erase(shell_marks.begin(),
+                      std::lower_bound(shell_marks.begin(), shell_marks.end(),
+                                       tail_first + dropped, by_line));
+    for (auto &image : images) {
+        if (image.line >= first && image.line < old_tail && head_rows > 0) {
+            reflow_images.push_back(std::move(image));
+        }
+    }
+    images.erase(std::remove_if(images.begin(), images.end(),
+                                [old_tail](const ImagePlacement &p) { return p.line < old_tail; }),
+                 images.end());
+    for (auto &image : images) {
+        int64_t row;
+        int col;
+        tail_index.map(image.line - old_tail, image.col, row, col);
+        image.line = tail_first + row;
+        image.col  = std::min(col, term_cols - 1);
+    }
+
+    if (head_rows == 0) {
+        // Nothing of the head is kept.
+        reflow_source.clear();
+        reflow_wraps.clear();
+        head_index = ReflowIndex();
+        return;
+    }
+    reflow_job = std::async(std::launch::async,
+                            [this, old_cols, new_cols] { reflow_head(old_cols, new_cols); });
+}
+
+//
+// Lay out and build rows of the head, in background.
+// Rows above the room left in history are not built at all.
+//
+void AnsiLogic::reflow_head(int old_cols, int new_cols)
+{
+    std::rotate(reflow_source.begin(), reflow_source.begin() + reflow_ring_first,
+                reflow_source.end());
+    std::rotate(reflow_wraps.begin(), reflow_wraps.begin() + reflow_ring_first,
+                reflow_wraps.end());
+    reflow_source.resize(reflow_split);
+    reflow_wraps.resize(reflow_split);
+    head_index.build(reflow_source, reflow_wraps, old_cols, new_cols, -1, 0);
+
+    int64_t total  = head_index.get_new_rows();
+    reflow_dropped = std::max<int64_t>(total - reflow_room, 0);
+    reflow_history.resize(total - reflow_dropped);
+    reflow_wraps.resize(reflow_history.size());
+    for (size_t k = 0; k < reflow_history.size(); ++k) {
+        reflow_history[k].reserve(new_cols);
+        reflow_wraps[k] = head_index.is_wrapped(reflow_dropped + k);
+    }
+    auto fill = [this](size_t begin, size_t end) {
+        head_index.fill(reflow_source, reflow_dropped + begin, reflow_dropped + end,
+                        &reflow_history[begin]);
+    };
+    parallel_for(reflow_history.size(), ReflowIndex::min_chunk, fill);
+    reflow_source.clear();
+}
+
+//
+// Wait for reflow of history, and put its rows before lines scrolled since.
+// Marks and images of the head get their new line numbers.
+//
+void AnsiLogic::finish_reflow()
+{
+    if (!reflow_job.valid())
+        return;
+    reflow_job.get();
+
+    for (auto &line : history) {
+        reflow_history.push_back(std::move(line));
+    }
+    reflow_wraps.insert(reflow_wraps.end(), history_wrapped.begin(), history_wrapped.end());
+    std::swap(history, reflow_history);
+    std::swap(history_wrapped, reflow_wraps);
+    reflow_history.clear();
+    reflow_wraps.clear();
+    history_first = 0;
+
+    // Lines scrolled meanwhile may have taken the room of the head.
+    if (get_history_size() > history_limit) {
+        int excess = get_history_size() - history_limit;
+        history.erase(history.begin(), history.begin() + excess);
+        history_wrapped.erase(history_wrapped.begin(), history_wrapped.begin() + excess);
+    }
+
+    // Marks and images of the head go before the others, unless dropped.
+    int64_t head_first = reflow_tail_first - head_index.get_new_rows();
+    for (auto &mark : reflow_marks) {
+        int64_t row;
+        head_index.map(mark.line - reflow_first, mark.col, row, mark.col);
+        mark.line = head_first + row;
+    }
+    auto kept = std::lower_bound(reflow_marks.begin(), reflow_marks.end(), first_line(),
+                                 [](const ShellMark &m, int64_t line) { return m.line < line; });
+    shell_marks.insert(shell_marks.begin(), kept, reflow_marks.end());
+    for (auto &image : reflow_images) {
+        int64_t row;
+        int col;
+        head_index.map(image.line - reflow_first, image.col, row, col);
+        image.line = head_first + row;
+        image.col  = std::min(col, term_cols - 1);
+    }
+    images.insert(images.begin(), std::make_move_iterator(reflow_images.begin()),
+                  std::make_move_iterator(reflow_images.end()));
+    reflow_marks.clear();
+    reflow_images.clear();
+}
+
+//
+// Line number after the last reflow, for a line number before it.
+// Lines of the head are known when it is laid out.
+//
+int64_t AnsiLogic::reflowed_line(int64_t line) const
+{
+    int64_t row;
+    int col;
+    if (line >= reflow_first + reflow_split) {
+        tail_index.map(line - reflow_first - reflow_split, 0, row, col);
+        return reflow_tail_first + row;
+    }
+    if (reflow_job.valid()) {
+        reflow_job.wait();
+    }
+    if (line < reflow_first)
+        return line;
+    if (head_index.get_line_count() == 0) {
+        // Head was dropped.
+        return reflow_tail_first - 1;
+    }
+    head_index.map(line - reflow_first, 0, row, col);
+    return reflow_tail_first - head_index.get_new_rows() + row;
 }
 
 std::vector<int> AnsiLogic::process_input(const char *buffer, size_t length)
 {
+    if (reflow_job.valid() &&
+        reflow_job.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+        finish_reflow();
+    }
     std::vector<int> dirty_rows;
     size_t i = 0;
     while (i < length) {
@@ -85,31 +502,15 @@ std::vector<int> AnsiLogic::process_input(const char *buffer, size_t length)
                 ++i;
                 break;
             case '\n':
-                cursor.row++;
-                cursor.col = 0;
-                if (cursor.row >= term_rows) {
-                    scroll_up();
-                    for (int r = 0; r < term_rows; ++r) {
-                        dirty_rows.push_back(r);
-                    }
-                } else {
-                    dirty_rows.push_back(cursor.row);
-                }
+                next_row(false, dirty_rows);
+                carriage_return();
                 ++i;
                 break;
             case '\r':
-                cursor.col = 0;
+                carriage_return();
                 if (i + 1 < length && buffer[i + 1] == '\n') {
                     ++i;
-                    cursor.row++;
-                    if (cursor.row >= term_rows) {
-                        scroll_up();
-                        for (int r = 0; r < term_rows; ++r) {
-                            dirty_rows.push_back(r);
-                        }
-                    } else {
-                        dirty_rows.push_back(cursor.row);
-                    }
+                    next_row(false, dirty_rows);
                 } else {
                     dirty_rows.push_back(cursor.row);
                 }
@@ -124,17 +525,23 @@ std::vector<int> AnsiLogic::process_input(const char *buffer, size_t length)
                 ++i;
                 break;
             case '\t':
-                cursor.col = (cursor.col + 8) / 8 * 8;
-                if (cursor.col >= term_cols) {
-                    cursor.col = term_cols - 1;
-                }
+                cursor.col = next_tab_stop(cursor.col);
+                dirty_rows.push_back(cursor.row);
                 ++i;
                 break;
             case '\7':
-                // TODO: make a sound.
+                // Bell is signalled by the caller, no rows change.
+                bell_pending = true;
                 ++i;
                 break;
             default:
+                // Fast path for runs of printable ASCII
+                if (size_t count = simd::scan_printable(&buffer[i], length - i)) {
+                    put_ascii_run(&buffer[i], count, dirty_rows);
+                    i += count;
+                    break;
+                }
+
                 // Decode UTF-8 sequence
                 wchar_t ch = 0;
                 int bytes  = 0;
@@ -158,21 +565,7 @@ std::vector<int> AnsiLogic::process_input(const char *buffer, size_t length)
                     continue;
                 }
 
-                if (cursor.col < term_cols && cursor.row < term_rows) {
-                    text_buffer[cursor.row][cursor.col] = { ch, current_attr };
-                    cursor.col++;
-                    dirty_rows.push_back(cursor.row);
-                }
-                if (cursor.col >= term_cols) {
-                    cursor.col = 0;
-                    cursor.row++;
-                    if (cursor.row >= term_rows) {
-                        scroll_up();
-                        for (int r = 0; r < term_rows; ++r) {
-                            dirty_rows.push_back(r);
-                        }
-                    }
-                }
+                put_char(ch, dirty_rows);
                 i += bytes;
             }
             break;
@@ -185,6 +578,41 @@ std::vector<int> AnsiLogic::process_input(const char *buffer, size_t length)
                 ansi_seq += c;
                 // std::cerr << "Received [, transitioning to CSI state" << std::endl;
                 break;
+            case ']':
+                state = AnsiState::OSC;
+                ansi_seq.clear();
+                break;
+            case 'D':
+                // IND: index, scrolling at the bottom margin
+                next_row(false, dirty_rows);
+                state = AnsiState::NORMAL;
+                break;
+            case 'E':
+                // NEL: next line
+                next_row(false, dirty_rows);
+                carriage_return();
+                state = AnsiState::NORMAL;
+                break;
+            case 'M':
+                // RI: reverse index, scrolling down at the top margin
+                reverse_index(dirty_rows);
+                state = AnsiState::NORMAL;
+                break;
+            case 'H':
+                // HTS: set tab stop at the cursor
+                tab_stops[cursor.col / 64] |= uint64_t(1) << (cursor.col % 64);
+                state = AnsiState::NORMAL;
+                break;
+            case '7':
+                // DECSC: save cursor and rendition
+                save_cursor();
+                state = AnsiState::NORMAL;
+                break;
+            case '8':
+                // DECRC: restore cursor and rendition
+                restore_cursor();
+                state = AnsiState::NORMAL;
+                break;
             case 'c':
                 // std::cerr << "Received ESC c, processing reset" << std::endl;
                 reset_state();
@@ -205,7 +633,7 @@ std::vector<int> AnsiLogic::process_input(const char *buffer, size_t length)
 
         case AnsiState::CSI:
             ansi_seq += c;
-            if (std::isalpha(c)) {
+            if (c >= 0x40 && c <= 0x7e) {
                 // std::cerr << "Received CSI final char: " << c << std::endl;
                 parse_ansi_sequence(ansi_seq, dirty_rows);
                 state = AnsiState::NORMAL;
@@ -213,6 +641,32 @@ std::vector<int> AnsiLogic::process_input(const char *buffer, size_t length)
             }
             ++i;
             break;
+
+        case AnsiState::OSC:
+            // Operating system command, terminated by BEL or ST (ESC \).
+            // Backslash after ESC is then ignored as unknown escape.
+            if (c == '\7' || c == '\033') {
+                parse_osc_sequence(ansi_seq, dirty_rows);
+                state = (c == '\033') ? AnsiState::ESCAPE : AnsiState::NORMAL;
+                ansi_seq.clear();
+                image_decoder.reset();
+            } else if (image_decoder) {
+                // Image payload goes to the decoder up to the terminator, not to the sequence.
+                const char *end = std::find_if(&buffer[i], &buffer[length],
+                                               [](char ch) { return ch == '\7' || ch == '\033'; });
+                image_decoder->feed_base64(&buffer[i], end - &buffer[i]);
+                i = end - buffer;
+                break;
+            } else if (ansi_seq.size() < max_osc_length) {
+                ansi_seq += c;
+                if (c == ':' && ansi_seq.compare(0, 10, "1337;File=") == 0) {
+                    // Files not shown inline are skipped, as if they were too large.
+                    bool show = (ansi_seq.find("inline=1") != std::string::npos);
+                    image_decoder = std::make_unique<ImageDecoder>(show ? max_image_bytes : 0);
+                }
+            }
+            ++i;
+            break;
         }
     }
     // Remove duplicates
@@ -221,6 +675,262 @@ std::vector<int> AnsiLogic::process_input(const char *buffer, size_t length)
     return dirty_rows;
 }
 
+//
+// Put a character at the cursor, and wrap at the end of the row,
+// or at the right margin when the cursor is between left and right margins.
+//
+void AnsiLogic::put_char(wchar_t ch, std::vector<int> &dirty_rows)
+{
+    bool inside = in_column_margins();
+    int right   = inside ? margin_right + 1 : term_cols;
+    if (cursor.col < right && cursor.row < term_rows) {
+        text_buffer[cursor.row][cursor.col] = { ch, current_attr };
+        cursor.col++;
+        dirty_rows.push_back(cursor.row);
+    }
+    if (cursor.col >= right) {
+        wrap_row(inside, dirty_rows);
+    }
+    last_char = ch;
+}
+
+//
+// Put a run of printable ASCII characters on the screen.
+// Same as storing them one by one, but row by row.
+//
+void AnsiLogic::put_ascii_run(const char *text, size_t count, std::vector<int> &dirty_rows)
+{
+    last_char = static_cast<unsigned char>(text[count - 1]);
+    while (count > 0) {
+        // Left of the left margin, the run is split there: then it's between the margins.
+        bool inside = in_column_margins();
+        int right   = inside ? margin_right + 1 : term_cols;
+        int stop    = (cursor.col < margin_left) ? margin_left : right;
+        if (cursor.col < stop) {
+            size_t n   = std::min<size_t>(count, stop - cursor.col);
+            auto &line = text_buffer[cursor.row];
+            for (size_t k = 0; k < n; ++k) {
+                line[cursor.col + k] = { static_cast<wchar_t>(text[k]), current_attr };
+            }
+            cursor.col += n;
+            text += n;
+            count -= n;
+            dirty_rows.push_back(cursor.row);
+        }
+        if (cursor.col >= right) {
+            wrap_row(inside, dirty_rows);
+        }
+    }
+}
+
+//
+// Continue on the next row, from the left margin when wrapped inside the margins.
+// Only rows of full width are marked as wrapped, to be joined by reflow.
+//
+void AnsiLogic::wrap_row(bool inside, std::vector<int> &dirty_rows)
+{
+    cursor.col = inside ? margin_left : 0;
+    next_row(cursor.col == 0 && (!inside || margin_right == term_cols - 1), dirty_rows);
+}
+
+//
+// Return to the left margin, or to the first column when left of it.
+//
+void AnsiLogic::carriage_return()
+{
+    cursor.col = (cursor.col >= margin_left) ? margin_left : 0;
+}
+
+//
+// Cursor leaves current row by line feed or by wrap at the right margin.
+//
+void AnsiLogic::end_row(bool wrap)
+{
+    wrapped[cursor.row] = wrap;
+    if (row_handler) {
+        row_handler(screen_line(cursor.row), text_buffer[cursor.row], wrap);
+    }
+}
+
+//
+// Line feed: move cursor to the next row, or scroll the region up at its bottom margin.
+// Outside of left and right margins, there is nothing to scroll.
+//
+void AnsiLogic::next_row(bool wrap, std::vector<int> &dirty_rows)
+{
+    end_row(wrap);
+    if (cursor.row == margin_bottom && in_column_margins()) {
+        scroll_rect(scroll_region(), 1, dirty_rows);
+    } else if (cursor.row < term_rows - 1) {
+        cursor.row++;
+    }
+    dirty_rows.push_back(cursor.row);
+}
+
+//
+// Move cursor to the previous row, or scroll the region down at its top margin.
+//
+void AnsiLogic::reverse_index(std::vector<int> &dirty_rows)
+{
+    if (cursor.row == margin_top && in_column_margins()) {
+        scroll_rect(scroll_region(), -1, dirty_rows);
+    } else if (cursor.row > 0) {
+        cursor.row--;
+    }
+}
+
+void AnsiLogic::reset_margins()
+{
+    margin_top     = 0;
+    margin_bottom  = term_rows - 1;
+    margin_left    = 0;
+    margin_right   = term_cols - 1;
+    lr_margin_mode = false;
+}
+
+bool AnsiLogic::in_margins() const
+{
+    return cursor.row >= margin_top && cursor.row <= margin_bottom && in_column_margins();
+}
+
+bool AnsiLogic::in_column_margins() const
+{
+    return cursor.col >= margin_left && cursor.col <= margin_right;
+}
+
+//
+// Resize tab stops for the current width. Stops beyond the width are cleared,
+// so columns added later get default stops.
+//
+void AnsiLogic::resize_tab_stops()
+{
+    tab_stops.resize((term_cols + 63) / 64);
+    for (int c = term_cols; c < int(tab_stops.size()) * 64; ++c) {
+        tab_stops[c / 64] &= ~(uint64_t(1) << (c % 64));
+    }
+    for (int c = tab_stop_cols; c < term_cols; ++c) {
+        if (c % 8 == 0) {
+            tab_stops[c / 64] |= uint64_t(1) << (c % 64);
+        }
+    }
+    tab_stop_cols = term_cols;
+}
+
+//
+// Find tab stop after the column, or the last column when none.
+// Words of the bitset are scanned for the lowest bit set.
+//
+int AnsiLogic::next_tab_stop(int col) const
+{
+    for (int c = col + 1; c < term_cols; c = (c | 63) + 1) {
+        uint64_t word = tab_stops[c / 64] >> (c % 64);
+        if (word) {
+            return std::min(c + __builtin_ctzll(word), term_cols - 1);
+        }
+    }
+    return term_cols - 1;
+}
+
+//
+// Find tab stop before the column, or the first column when none.
+//
+int AnsiLogic::prev_tab_stop(int col) const
+{
+    for (int c = col - 1; c >= 0; c = (c & ~63) - 1) {
+        uint64_t word = tab_stops[c / 64] << (63 - c % 64);
+        if (word) {
+            return c - __builtin_clzll(word);
+        }
+    }
+    return 0;
+}
+
+//
+// Scroll area up by count rows, or down when count is negative; rows coming in are blank.
+// Rows of full width are moved as a whole; when the whole screen scrolls up,
+// rows go to the history.
+//
+void AnsiLogic::scroll_rect(const Rect &rect, int count, std::vector<int> &dirty_rows)
+{
+    int height = rect.bottom - rect.top + 1;
+    int shift  = std::min(std::abs(count), height);
+    if (shift == 0 || rect.left > rect.right)
+        return;
+
+    bool full_width = (rect.left == 0 && rect.right == term_cols - 1);
+    int incoming    = (count > 0) ? rect.bottom - shift + 1 : rect.top;
+    if (full_width && count > 0 && height == term_rows) {
+        int row = cursor.row;
+        for (int k = 0; k < shift; ++k) {
+            scroll_up();
+        }
+        cursor.row = row;
+    } else if (full_width) {
+        auto first      = text_buffer.begin() + rect.top;
+        auto last       = first + height;
+        auto wrap_first = wrapped.begin() + rect.top;
+        auto wrap_last  = wrap_first + height;
+        if (count > 0) {
+            std::rotate(first, first + shift, last);
+            std::rotate(wrap_first, wrap_first + shift, wrap_last);
+        } else {
+            std::rotate(first, last - shift, last);
+            std::rotate(wrap_first, wrap_last - shift, wrap_last);
+        }
+        for (int r = incoming; r < incoming + shift; ++r) {
+            text_buffer[r].assign(term_cols, { L' ', current_attr });
+            wrapped[r] = false;
+        }
+    } else {
+        for (int k = 0; k < height - shift; ++k) {
+            int dst    = (count > 0) ? rect.top + k : rect.bottom - k;
+            int src    = (count > 0) ? dst + shift : dst - shift;
+            auto first = text_buffer[src].begin() + rect.left;
+            std::copy(first, first + (rect.right - rect.left + 1),
+                      text_buffer[dst].begin() + rect.left);
+        }
+        for (int r = incoming; r < incoming + shift; ++r) {
+            std::fill(text_buffer[r].begin() + rect.left, text_buffer[r].begin() + rect.right + 1,
+                      Char{ L' ', current_attr });
+        }
+    }
+
+    int delta = (count > 0) ? shift : -shift;
+    if (scroll_damage && full_width) {
+        // Rows changed so far move along; only rows coming in are new.
+        for (auto &r : dirty_rows) {
+            if (r >= rect.top && r <= rect.bottom) {
+                r -= delta;
+                if (r < rect.top || r > rect.bottom)
+                    r = -1;
+            }
+        }
+        dirty_rows.erase(std::remove(dirty_rows.begin(), dirty_rows.end(), -1),
+                         dirty_rows.end());
+        for (int r = incoming; r < incoming + shift; ++r) {
+            dirty_rows.push_back(r);
+        }
+        if (dirty_rows.size() > 2 * static_cast<size_t>(term_rows)) {
+            std::sort(dirty_rows.begin(), dirty_rows.end());
+            dirty_rows.erase(std::unique(dirty_rows.begin(), dirty_rows.end()),
+                             dirty_rows.end());
+        }
+    } else {
+        for (int r = rect.top; r <= rect.bottom; ++r) {
+            dirty_rows.push_back(r);
+        }
+    }
+    if (scroll_damage) {
+        if (!scrolls.empty() && scrolls.back().top == rect.top &&
+            scrolls.back().bottom == rect.bottom && scrolls.back().left == rect.left &&
+            scrolls.back().right == rect.right) {
+            scrolls.back().count += delta;
+        } else {
+            scrolls.push_back({ rect.top, rect.left, rect.bottom, rect.right, delta });
+        }
+    }
+}
+
 static std::string wchar_to_utf8(wchar_t wc)
 {
     std::string utf8;
@@ -397,7 +1107,57 @@ static int get_param(const std::vector<int> &params, int index, int default_valu
     return default_value;
 }
 
-void AnsiLogic::parse_ansi_sequence(const std::string &seq, std::vector<int> &dirty_rows)
+void AnsiLogic::save_cursor()
+{
+    saved_cursor = { cursor, current_attr };
+}
+
+//
+// Restore saved cursor, limited to the screen, which may have been resized since.
+//
+void AnsiLogic::restore_cursor()
+{
+    cursor.row   = std::min(saved_cursor.cursor.row, term_rows - 1);
+    cursor.col   = std::min(saved_cursor.cursor.col, term_cols - 1);
+    current_attr = saved_cursor.attr;
+}
+
+//
+// Push current rendition. Parameters select what is restored by pop:
+// 30 foreground, 31 background; none means all. Other attributes are not supported.
+// When the stack is full, the push is ignored.
+//
+void AnsiLogic::push_style(const std::vector<int> &params)
+{
+    uint8_t mask = 0;
+    for (int p : params) {
+        mask |= (p == 30) ? PushedStyle::FG : (p == 31) ? PushedStyle::BG : 0;
+    }
+    if (params.empty() || (params.size() == 1 && params[0] == 0)) {
+        mask = PushedStyle::FG | PushedStyle::BG;
+    }
+    if (style_stack.size() < max_style_stack) {
+        style_stack.push_back({ current_attr, mask });
+    }
+}
+
+void AnsiLogic::pop_style()
+{
+    if (style_stack.empty()) {
+        return;
+    }
+    const PushedStyle &top = style_stack.back();
+    const CharAttr &pushed = top.attr;
+    if (top.mask & PushedStyle::FG) {
+        current_attr.fg = pushed.fg;
+    }
+    if (top.mask & PushedStyle::BG) {
+        current_attr.bg = pushed.bg;
+    }
+    style_stack.pop_back();
+}
+
+void AnsiLogic::parse_ansi_sequence(std::string_view seq, std::vector<int> &dirty_rows)
 {
     if (seq.empty() || seq[0] != '[') {
         // std::cerr << "Invalid CSI sequence: " << seq << std::endl;
@@ -407,13 +1167,20 @@ void AnsiLogic::parse_ansi_sequence(const std::string &seq, std::vector<int> &di
     // std::cerr << "Processing CSI sequence: " << seq << std::endl;
     std::vector<int> params;
     std::string param_str;
+    char marker       = 0; // Private parameters, like '?'
+    char intermediate = 0; // Like '$' in CSI ... $ v
 
     // Process all characters up to the final character
     for (size_t i = 1; i < seq.size(); ++i) {
-        char c = seq[i];
+        char c    = seq[i];
+        bool last = (i == seq.size() - 1);
         if (std::isdigit(c)) {
             param_str += c;
-        } else if (c == ';' || std::isalpha(c)) {
+        } else if (c >= 0x3c && c <= 0x3f && i == 1) {
+            marker = c;
+        } else if (c >= 0x20 && c <= 0x2f && !last) {
+            intermediate = c;
+        } else if (c == ';' || last) {
             if (!param_str.empty()) {
                 try {
                     params.push_back(std::stoi(param_str));
@@ -426,7 +1193,7 @@ void AnsiLogic::parse_ansi_sequence(const std::string &seq, std::vector<int> &di
             } else {
                 params.push_back(0);
             }
-            if (std::isalpha(c)) {
+            if (last) {
                 break; // Final character reached
             }
         }
@@ -443,6 +1210,29 @@ void AnsiLogic::parse_ansi_sequence(const std::string &seq, std::vector<int> &di
         }
     }
 
+    if (intermediate == '$') {
+        parse_rect_sequence(seq.back(), params, dirty_rows);
+        return;
+    }
+    if (intermediate == '"' && seq.back() == 'q') {
+        // DECSCA: protect characters written from now on, or not
+        current_attr.protect = (get_param(params, 0, 0) == 1);
+        return;
+    }
+    if (intermediate == '#' && seq.back() == '{') {
+        // XTPUSHSGR
+        push_style(params);
+        return;
+    }
+    if (intermediate == '#' && seq.back() == '}') {
+        // XTPOPSGR
+        pop_style();
+        return;
+    }
+    if (intermediate) {
+        return;
+    }
+
     // Process final character
     switch (seq.back()) {
     case 'm': {
@@ -450,8 +1240,10 @@ void AnsiLogic::parse_ansi_sequence(const std::string &seq, std::vector<int> &di
         for (size_t i = 0; i < params.size(); ++i) {
             int p = params[i];
             if (p == 0) {
-                current_colors = normal_colors;
-                current_attr = CharAttr(); // Light Gray on Black
+                bool protect         = current_attr.protect;
+                current_colors       = normal_colors;
+                current_attr         = CharAttr(); // Light Gray on Black
+                current_attr.protect = protect;    // Not a rendition
             } else if (p == 1) {
                 current_colors = bright_colors;
                 current_attr.fg = bright_colors[7]; // Bright White, same background
@@ -459,6 +1251,10 @@ void AnsiLogic::parse_ansi_sequence(const std::string &seq, std::vector<int> &di
                 current_attr.fg = current_colors[p - 30];
             } else if (p >= 40 && p <= 47) {
                 current_attr.bg = current_colors[p - 40];
+            } else if (p == 39) {
+                current_attr.fg = CharAttr().fg;
+            } else if (p == 49) {
+                current_attr.bg = CharAttr().bg;
             } else if (p >= 90 && p <= 97) {
                 current_attr.fg = bright_colors[p - 90];
             } else if (p >= 100 && p <= 107) {
@@ -467,11 +1263,78 @@ void AnsiLogic::parse_ansi_sequence(const std::string &seq, std::vector<int> &di
         }
         break;
     }
+    case 'c':
+        // Primary device attributes: VT420 with ANSI color and rectangular editing
+        if (!marker && get_param(params, 0, 0) == 0) {
+            respond("\033[?64;22;28c");
+        }
+        break;
+
     case 'H':
+    case 'f':
         cursor.row = std::max(0, std::min(get_param(params, 0, 1) - 1, term_rows - 1));
         cursor.col = std::max(0, std::min(get_param(params, 1, 1) - 1, term_cols - 1));
         break;
 
+    case 'G':
+    case '`':
+        // HPA: column
+        cursor.col = std::min(get_param(params, 0, 1) - 1, term_cols - 1);
+        break;
+
+    case 'd':
+        // VPA: row
+        cursor.row = std::min(get_param(params, 0, 1) - 1, term_rows - 1);
+        break;
+
+    case 'b':
+        // REP: repeat the last character, at most a screenful of times
+        if (last_char) {
+            int count = std::min(get_param(params, 0, 1), term_cols * term_rows);
+            for (int k = 0; k < count; ++k) {
+                put_char(last_char, dirty_rows);
+            }
+        }
+        break;
+
+    case 'X': {
+        // ECH: erase characters from the cursor, up to the right margin; cursor stays
+        auto &line = text_buffer[cursor.row];
+        int right  = in_column_margins() ? margin_right + 1 : term_cols;
+        int count  = std::min(get_param(params, 0, 1), right - cursor.col);
+        std::fill(line.begin() + cursor.col, line.begin() + cursor.col + count,
+                  Char{ L' ', current_attr });
+        dirty_rows.push_back(cursor.row);
+        break;
+    }
+
+    case '@':
+    case 'P': {
+        // ICH, DCH: insert blanks or delete characters at the cursor, up to the end of the row,
+        // or up to the right margin when the cursor is between left and right margins
+        auto &line = text_buffer[cursor.row];
+        auto first = line.begin() + cursor.col;
+        auto last  = in_column_margins() ? line.begin() + margin_right + 1 : line.end();
+        int count  = std::min<int>(get_param(params, 0, 1), last - first);
+        if (seq.back() == '@') {
+            std::copy_backward(first, last - count, last);
+            std::fill(first, first + count, Char{ L' ', current_attr });
+        } else {
+            std::copy(first + count, last, first);
+            std::fill(last - count, last, Char{ L' ', current_attr });
+        }
+        dirty_rows.push_back(cursor.row);
+        break;
+    }
+
+    case 'n':
+        // DSR: report cursor position
+        if (!marker && get_param(params, 0, 0) == 6) {
+            respond("\033[" + std::to_string(cursor.row + 1) + ";" +
+                    std::to_string(cursor.col + 1) + "R");
+        }
+        break;
+
     case 'A':
         cursor.row = std::max(0, cursor.row - get_param(params, 0, 1));
         break;
@@ -528,6 +1391,103 @@ void AnsiLogic::parse_ansi_sequence(const std::string &seq, std::vector<int> &di
         }
         break;
 
+    case 'r':
+        // DECSTBM: top and bottom margins; cursor goes home
+        if (!marker) {
+            int top    = get_param(params, 0, 1) - 1;
+            int bottom = (params.size() > 1 && params[1] > 0) ? params[1] : term_rows;
+            bottom     = std::min(bottom, term_rows) - 1;
+            if (top < bottom) {
+                margin_top    = top;
+                margin_bottom = bottom;
+                cursor        = Cursor();
+            }
+        }
+        break;
+
+    case 's':
+        // DECSLRM: left and right margins, when enabled by DECLRMM; cursor goes home.
+        // Otherwise SCOSC: save cursor and rendition.
+        if (!marker && !lr_margin_mode) {
+            save_cursor();
+        } else if (!marker) {
+            int left  = get_param(params, 0, 1) - 1;
+            int right = (params.size() > 1 && params[1] > 0) ? params[1] : term_cols;
+            right     = std::min(right, term_cols) - 1;
+            if (left < right) {
+                margin_left  = left;
+                margin_right = right;
+                cursor       = Cursor();
+            }
+        }
+        break;
+
+    case 'I':
+    case 'Z':
+        // CHT, CBT: move forward or backward by a number of tab stops
+        if (!marker) {
+            int count = get_param(params, 0, 1);
+            for (int k = 0; k < count; ++k) {
+                int col = (seq.back() == 'I') ? next_tab_stop(cursor.col)
+                                              : prev_tab_stop(cursor.col);
+                if (col == cursor.col) {
+                    break;
+                }
+                cursor.col = col;
+            }
+            dirty_rows.push_back(cursor.row);
+        }
+        break;
+
+    case 'g':
+        // TBC: clear tab stop at the cursor, or all of them
+        if (!marker && get_param(params, 0, 0) == 0) {
+            tab_stops[cursor.col / 64] &= ~(uint64_t(1) << (cursor.col % 64));
+        } else if (!marker && get_param(params, 0, 0) == 3) {
+            std::fill(tab_stops.begin(), tab_stops.end(), 0);
+        }
+        break;
+
+    case 'u':
+        // SCORC: restore cursor and rendition
+        if (!marker) {
+            restore_cursor();
+        }
+        break;
+
+    case 'h':
+    case 'l':
+        // DECLRMM: enable left and right margins
+        if (marker == '?' && std::find(params.begin(), params.end(), 69) != params.end()) {
+            lr_margin_mode = (seq.back() == 'h');
+            margin_left    = 0;
+            margin_right   = term_cols - 1;
+        }
+        break;
+
+    case 'L':
+    case 'M':
+        // IL, DL: insert or delete lines at the cursor, within the scrolling region
+        if (in_margins()) {
+            int count = get_param(params, 0, 1);
+            scroll_rect({ cursor.row, margin_left, margin_bottom, margin_right },
+                        (seq.back() == 'L') ? -count : count, dirty_rows);
+            cursor.col = margin_left;
+        }
+        break;
+
+    case 'S':
+        // SU: scroll region up
+        scroll_rect(scroll_region(), get_param(params, 0, 1), dirty_rows);
+        break;
+
+    case 'T':
+        // SD: scroll region down; with more parameters it's mouse tracking
+        if (params.size() <= 1) {
+            scroll_rect(scroll_region(), -get_param(params, 0, 1), dirty_rows);
+        }
+        break;
+
     case 'K':
         // std::cerr << "Processing ESC [ " << mode << "K" << std::endl;
         switch (get_param(params, 0, 0)) {
@@ -553,11 +1513,377 @@ void AnsiLogic::parse_ansi_sequence(const std::string &seq, std::vector<int> &di
     }
 }
 
+//
+// Rectangular area operations of VT420: CSI ... $ v, x, z or {.
+// Page numbers are ignored, there is only one page.
+//
+void AnsiLogic::parse_rect_sequence(char final, const std::vector<int> &params,
+                                    std::vector<int> &dirty_rows)
+{
+    switch (final) {
+    case 'v':
+        // DECCRA: copy area Pt;Pl;Pb;Pr;Pp to Pt;Pl;Pp
+        copy_rect(get_rect(params, 0), get_param(params, 5, 1) - 1, get_param(params, 6, 1) - 1,
+                  dirty_rows);
+        break;
+    case 'x': {
+        // DECFRA: fill area Pt;Pl;Pb;Pr with character Pch, in current rendition
+        int ch = params.empty() ? 0 : params[0];
+        if ((ch >= 32 && ch <= 126) || (ch >= 160 && ch <= 255)) {
+            fill_rect(get_rect(params, 1), { wchar_t(ch), current_attr }, false, dirty_rows);
+        }
+        break;
+    }
+    case 'z':
+        // DECERA: erase area Pt;Pl;Pb;Pr
+        fill_rect(get_rect(params, 0), { L' ', current_attr }, false, dirty_rows);
+        break;
+    case '{':
+        // DECSERA: erase characters not protected by DECSCA, keep renditions
+        fill_rect(get_rect(params, 0), { L' ', current_attr }, true, dirty_rows);
+        break;
+    }
+}
+
+//
+// Area from four parameters: top, left, bottom, right.
+// Missing or zero values stand for the screen edges; the area is clipped to the screen.
+//
+AnsiLogic::Rect AnsiLogic::get_rect(const std::vector<int> &params, size_t index) const
+{
+    auto param = [&params, index](size_t k, int default_value) {
+        return (params.size() > index + k && params[index + k] > 0) ? params[index + k]
+                                                                     : default_value;
+    };
+    return { param(0, 1) - 1, param(1, 1) - 1, std::min(param(2, term_rows), term_rows) - 1,
+             std::min(param(3, term_cols), term_cols) - 1 };
+}
+
+//
+// Copy area to another place, which may overlap it.
+// Rows and cells are copied in the direction that doesn't overwrite the source.
+//
+void AnsiLogic::copy_rect(const Rect &src, int dst_row, int dst_col,
+                          std::vector<int> &dirty_rows)
+{
+    int height = std::min(src.bottom - src.top + 1, term_rows - dst_row);
+    int width  = std::min(src.right - src.left + 1, term_cols - dst_col);
+    if (height <= 0 || width <= 0)
+        return;
+
+    for (int k = 0; k < height; ++k) {
+        int n      = (dst_row > src.top) ? height - 1 - k : k;
+        auto first = text_buffer[src.top + n].begin() + src.left;
+        auto out   = text_buffer[dst_row + n].begin() + dst_col;
+        if (dst_col > src.left) {
+            std::copy_backward(first, first + width, out + width);
+        } else {
+            std::copy(first, first + width, out);
+        }
+        dirty_rows.push_back(dst_row + n);
+    }
+}
+
+//
+// Fill area with a character. Selective fill changes only characters not protected.
+//
+void AnsiLogic::fill_rect(const Rect &rect, const Char &fill, bool selective,
+                          std::vector<int> &dirty_rows)
+{
+    if (rect.top > rect.bottom || rect.left > rect.right)
+        return;
+
+    for (int r = rect.top; r <= rect.bottom; ++r) {
+        auto first = text_buffer[r].begin() + rect.left;
+        auto last  = text_buffer[r].begin() + rect.right + 1;
+        if (selective) {
+            for (auto it = first; it != last; ++it) {
+                if (!it->attr.protect) {
+                    it->ch = fill.ch;
+                }
+            }
+        } else {
+            std::fill(first, last, fill);
+        }
+        dirty_rows.push_back(r);
+    }
+}
+
+//
+// Queue a reply to the child. Replies nobody takes are dropped, beyond a limit.
+//
+void AnsiLogic::respond(std::string_view reply)
+{
+    if (responses.size() + reply.size() <= max_responses_length) {
+        responses += reply;
+    }
+}
+
+//
+// Process OSC sequence, without ESC ] and terminator.
+//
+void AnsiLogic::parse_osc_sequence(std::string_view seq, std::vector<int> &dirty_rows)
+{
+    // Inline image: 1337;File=args:payload, where payload was consumed by the decoder
+    if (seq.substr(0, 10) == "1337;File=") {
+        if (image_decoder) {
+            if (auto image = image_decoder->finish()) {
+                place_image(std::move(image), seq.substr(10), dirty_rows);
+            }
+        }
+        return;
+    }
+
+    // Shell integration: 133;A, 133;B, 133;C or 133;D[;exit_code]
+    if (seq.size() >= 5 && seq.substr(0, 4) == "133;") {
+        char kind = seq[4];
+        if (kind >= 'A' && kind <= 'D') {
+            add_shell_mark(kind);
+        }
+    }
+}
+
+size_t AnsiLogic::image_memory_in_use() const
+{
+    size_t bytes = image_decoder ? image_decoder->memory_in_use() : 0;
+    std::vector<const InlineImage *> counted;
+    for (const auto &p : images) {
+        if (std::find(counted.begin(), counted.end(), p.image.get()) == counted.end()) {
+            counted.push_back(p.image.get());
+            bytes += sizeof(InlineImage) + p.image->pixels.capacity();
+        }
+    }
+    return bytes;
+}
+
+//
+// Forget images above the screen, oldest first, until given number of bytes is released.
+// Pixels are released with the last placement of an image.
+// Return number of bytes actually released.
+//
+size_t AnsiLogic::drop_images(size_t bytes)
+{
+    size_t before = image_memory_in_use();
+    size_t after  = before;
+    for (auto it = images.begin(); it != images.end() && before - after < bytes;) {
+        if (it->line + it->rows <= screen_line(0)) {
+            it    = images.erase(it);
+            after = image_memory_in_use();
+        } else {
+            ++it;
+        }
+    }
+    return before - after;
+}
+
+//
+// Put image at the cursor, and move the cursor to its bottom right corner.
+// Images with the same contents share pixels.
+//
+void AnsiLogic::place_image(std::shared_ptr<InlineImage> image, std::string_view args,
+                            std::vector<int> &dirty_rows)
+{
+    // Forget images scrolled out of history.
+    // While history is reflowed, that is left until it is done.
+    if (!reflow_job.valid()) {
+        int64_t first = first_line();
+        images.erase(std::remove_if(images.begin(), images.end(),
+                                    [first](const ImagePlacement &p) {
+                                        return p.line + p.rows <= first;
+                                    }),
+                     images.end());
+    }
+
+    std::shared_ptr<const InlineImage> pixels = std::move(image);
+    for (const auto &p : images) {
+        if (p.image->hash == pixels->hash && p.image->pixels == pixels->pixels) {
+            pixels = p.image;
+            break;
+        }
+    }
+
+    // Size is given in cells, in pixels (Npx) or in percent of the screen;
+    // otherwise it's the size of the image, or keeps the aspect ratio.
+    int width  = pixels->width;
+    int height = pixels->height;
+    int cols   = image_extent(args, "width", term_cols, cell_width);
+    int rows   = image_extent(args, "height", term_rows, cell_height);
+    if (cols <= 0 && rows <= 0) {
+        cols = (width + cell_width - 1) / cell_width;
+        rows = (height + cell_height - 1) / cell_height;
+    } else if (cols <= 0) {
+        int64_t w = int64_t(rows) * cell_height * width / height;
+        cols      = (w + cell_width - 1) / cell_width;
+    } else if (rows <= 0) {
+        int64_t h = int64_t(cols) * cell_width * height / width;
+        rows      = (h + cell_height - 1) / cell_height;
+    }
+    cols = std::clamp(cols, 1, term_cols);
+    rows = std::max(rows, 1);
+
+    images.push_back({ screen_line(cursor.row), cursor.col, cols, rows, std::move(pixels) });
+    dirty_rows.push_back(cursor.row);
+    for (int r = 1; r < rows; ++r) {
+        end_row(false);
+        cursor.row++;
+        if (cursor.row >= term_rows) {
+            scroll_up();
+        }
+        dirty_rows.push_back(cursor.row);
+    }
+    cursor.col = std::min(cursor.col + cols, term_cols - 1);
+    if (rows > 1) {
+        // Rows scrolled up, or not: all of them show the image.
+        for (int r = 0; r < term_rows; ++r) {
+            dirty_rows.push_back(r);
+        }
+    }
+}
+
+//
+// Size of image in cells, from argument like width=N, width=Npx or width=N%.
+// Return 0 for auto or missing size.
+//
+int AnsiLogic::image_extent(std::string_view args, std::string_view key, int screen_cells,
+                            int cell_pixels) const
+{
+    size_t pos = 0;
+    while (pos < args.size()) {
+        size_t end = std::min(args.find_first_of(";:", pos), args.size());
+        auto arg   = args.substr(pos, end - pos);
+        pos        = end + 1;
+        if (arg.size() <= key.size() || arg.substr(0, key.size()) != key ||
+            arg[key.size()] != '=')
+            continue;
+
+        auto value = arg.substr(key.size() + 1);
+        int number = 0;
+        size_t k   = 0;
+        for (; k < value.size() && std::isdigit(static_cast<unsigned char>(value[k])); ++k) {
+            number = std::min(number * 10 + (value[k] - '0'), 100000);
+        }
+        auto unit = value.substr(k);
+        if (k == 0)
+            return 0;
+        if (unit == "px")
+            return (number + cell_pixels - 1) / cell_pixels;
+        if (unit == "%")
+            return std::max(screen_cells * number / 100, 1);
+        return unit.empty() ? number : 0;
+    }
+    return 0;
+}
+
+void AnsiLogic::add_shell_mark(char kind)
+{
+    // Forget marks of lines dropped from history, when they make up a half.
+    // While history is reflowed, that is left until it is done.
+    if (!reflow_job.valid()) {
+        auto first = std::lower_bound(
+            shell_marks.begin(), shell_marks.end(), first_line(),
+            [](const ShellMark &m, int64_t line) { return m.line < line; });
+        if (first - shell_marks.begin() > static_cast<long>(shell_marks.size() / 2)) {
+            shell_marks.erase(shell_marks.begin(), first);
+        }
+    }
+
+    // Usually marks come in order, but the cursor may have been moved up.
+    ShellMark mark{ screen_line(cursor.row), cursor.col, kind };
+    auto pos = std::upper_bound(shell_marks.begin(), shell_marks.end(), mark,
+                                [](const ShellMark &a, const ShellMark &b) {
+                                    return a.line < b.line || (a.line == b.line && a.col < b.col);
+                                });
+    shell_marks.insert(pos, mark);
+}
+
+const Line *AnsiLogic::get_line(int64_t line) const
+{
+    if (line >= screen_line(term_rows)) {
+        return nullptr;
+    }
+    if (line >= lines_scrolled) {
+        return &text_buffer[line - lines_scrolled];
+    }
+    if (line < first_line()) {
+        return nullptr;
+    }
+    return &get_history_line(line - first_line());
+}
+
+//
+// Find line of the closest prompt before or after given line.
+// Prompt marks are found by binary search; other kinds of marks
+// are skipped, but there are at most three of them per prompt.
+//
+int64_t AnsiLogic::find_prompt(int64_t line, bool forward)
+{
+    finish_reflow();
+    auto by_line = [](const ShellMark &m, int64_t l) { return m.line < l; };
+    if (forward) {
+        auto it = std::lower_bound(shell_marks.begin(), shell_marks.end(), line + 1, by_line);
+        for (; it != shell_marks.end(); ++it) {
+            if (it->kind == 'A')
+                return it->line;
+        }
+    } else {
+        auto it = std::lower_bound(shell_marks.begin(), shell_marks.end(), line, by_line);
+        while (it != shell_marks.begin()) {
+            --it;
+            if (it->line < first_line())
+                break;
+            if (it->kind == 'A')
+                return it->line;
+        }
+    }
+    return -1;
+}
+
+//
+// Get text of the output of the last command, in UTF-8.
+// Output starts at the last C mark, and ends at the following D mark,
+// or at the cursor when the command is still running.
+//
+std::string AnsiLogic::last_command_output()
+{
+    finish_reflow();
+    auto it = std::find_if(shell_marks.rbegin(), shell_marks.rend(),
+                           [](const ShellMark &m) { return m.kind == 'C'; });
+    if (it == shell_marks.rend()) {
+        return "";
+    }
+    ShellMark start = *it;
+    ShellMark end{ screen_line(cursor.row), cursor.col, 'D' };
+    if (it != shell_marks.rbegin() && (it - 1)->kind == 'D') {
+        end = *(it - 1);
+    }
+
+    std::string text;
+    for (int64_t n = std::max(start.line, first_line()); n <= end.line; ++n) {
+        const Line *line = get_line(n);
+        if (!line)
+            break;
+        int from = (n == start.line) ? start.col : 0;
+        int to   = (n == end.line) ? end.col : line->size();
+        to       = std::min<int>(to, line->size());
+        while (to > from && (*line)[to - 1].ch == L' ') {
+            --to; // Trailing blanks
+        }
+        for (int col = from; col < to; ++col) {
+            text += wchar_to_utf8((*line)[col].ch);
+        }
+        if (n != end.line) {
+            text += '\n';
+        }
+    }
+    return text;
+}
+
 void AnsiLogic::clear_screen()
 {
     for (int r = 0; r < term_rows; ++r) {
-        text_buffer[r] = std::vector<Char>(term_cols, { L' ', current_attr });
+        text_buffer[r].assign(term_cols, { L' ', current_attr });
     }
+    wrapped.assign(term_rows, false);
     cursor.row = 0;
     cursor.col = 0;
 }
@@ -566,12 +1892,46 @@ void AnsiLogic::reset_state()
 {
     // std::cerr << "Processing ESC c: Resetting terminal state" << std::endl;
     current_attr = CharAttr();
+    reset_margins();
+    tab_stops.clear();
+    tab_stop_cols = 0;
+    resize_tab_stops();
+    saved_cursor = SavedCursor();
+    style_stack.clear();
+    images.erase(std::remove_if(images.begin(), images.end(),
+                                [this](const ImagePlacement &p) {
+                                    return p.line + p.rows > screen_line(0);
+                                }),
+                 images.end());
     clear_screen();
 }
 
+//
+// Scroll screen up by one line.
+// Top line goes to the history; when the history is full,
+// its oldest line is reused for the new bottom line.
+//
 void AnsiLogic::scroll_up()
 {
-    text_buffer.erase(text_buffer.begin());
-    text_buffer.push_back(std::vector<Char>(term_cols, { L' ', current_attr }));
+    std::rotate(text_buffer.begin(), text_buffer.begin() + 1, text_buffer.end());
+    bool wrap = wrapped.front();
+    wrapped.erase(wrapped.begin());
+    wrapped.push_back(false);
+    auto &line = text_buffer.back();
+    if (reflow_job.valid() && static_cast<int>(history.size()) >= history_limit) {
+        // Oldest line is reused: history must be in one piece.
+        finish_reflow();
+    }
+    if (history_limit > 0 && (reflow_job.valid() || get_history_size() < history_limit)) {
+        history.push_back(std::move(line));
+        history_wrapped.push_back(wrap);
+        line = Line(&arena);
+    } else if (history_limit > 0) {
+        std::swap(history[history_first], line);
+        history_wrapped[history_first] = wrap;
+        history_first = (history_first + 1) % history_limit;
+    }
+    line.assign(term_cols, { L' ', current_attr });
     cursor.row = term_rows - 1;
+    lines_scrolled++;
 }
@@ -28,10 +28,19 @@
 
 #include <cstdint>
 #include <cwchar>
+#include <functional>
+#include <future>
 #include <map>
+#include <memory>
+#include <memory_resource>
 #include <string>
+#include <string_view>
 #include <vector>
 
+#include "inline_image.h"
+#include "reflow.h"
+#include "session_arena.h"
+
 // Device-independent keycodes
 enum class KeyCode {
     // clang-format off
@@ -82,10 +91,11 @@ struct RgbColor {
 struct CharAttr {
     RgbColor fg{ 192, 192, 192 }; // Foreground color (default light gray)
     RgbColor bg{ 0, 0, 0 };       // Background color (default black)
+    bool protect{};               // Not erased by selective erase (DECSCA)
 
     bool operator==(const CharAttr &other) const
     {
-        return fg == other.fg && bg == other.bg;
+        return fg == other.fg && bg == other.bg && protect == other.protect;
     }
 };
 
@@ -95,6 +105,9 @@ struct Char {
     CharAttr attr;
 };
 
+// One line of characters, allocated from the session arena
+using Line = std::pmr::vector<Char>;
+
 // Cursor position
 struct Cursor {
     int row = 0;
@@ -102,19 +115,124 @@ struct Cursor {
 };
 
 // ANSI parsing states
-enum class AnsiState { NORMAL, ESCAPE, CSI };
+enum class AnsiState { NORMAL, ESCAPE, CSI, OSC };
+
+// Shell integration mark (OSC 133), at absolute line number
+struct ShellMark {
+    int64_t line;
+    int col;
+    char kind; // 'A' prompt, 'B' command, 'C' output, 'D' command finished
+};
+
+// Area of the screen scrolled by a number of rows: up when positive.
+// Bounds are inclusive, from zero.
+struct ScrollDamage {
+    int top, left, bottom, right;
+    int count;
+};
+
+// Inline image (OSC 1337), anchored at absolute line number
+struct ImagePlacement {
+    int64_t line;
+    int col;
+    int cols; // Size in cells
+    int rows;
+    std::shared_ptr<const InlineImage> image;
+};
 
 class AnsiLogic {
 public:
     AnsiLogic(int cols, int rows);
+    AnsiLogic(const AnsiLogic &) = delete;
+    AnsiLogic &operator=(const AnsiLogic &) = delete;
     void resize(int new_cols, int new_rows);
+    void trim_memory();
     std::vector<int> process_input(const char *buffer, size_t length);
     std::string process_key(const KeyInput &key);
-    const std::vector<std::vector<Char>> &get_text_buffer() const { return text_buffer; }
+    const std::pmr::vector<Line> &get_text_buffer() const { return text_buffer; }
     const Cursor &get_cursor() const { return cursor; }
     int get_cols() const { return term_cols; }
     int get_rows() const { return term_rows; }
 
+    // Row continues on the next row, wrapped at the right margin
+    bool is_wrapped(int row) const { return wrapped[row]; }
+
+    // Bell received since last call; a burst of bells counts as one
+    bool take_bell()
+    {
+        bool bell    = bell_pending;
+        bell_pending = false;
+        return bell;
+    }
+
+    // Replies to queries, like device attributes, to be sent to the child
+    std::string take_responses()
+    {
+        std::string reply;
+        reply.swap(responses);
+        return reply;
+    }
+
+    // With scroll damage, rows moved by scrolling are not reported as changed:
+    // scrolls are listed in order, and changed rows are given after all of them.
+    // Renderer can then move rows it has, instead of drawing them again.
+    void set_scroll_damage(bool enable) { scroll_damage = enable; }
+    std::vector<ScrollDamage> take_scrolls()
+    {
+        std::vector<ScrollDamage> list;
+        list.swap(scrolls);
+        return list;
+    }
+
+    // Handler is called when cursor leaves a row by line feed, or continues
+    // on the next row by wrap. Row is given by absolute line number.
+    using RowFunc = std::function<void(int64_t line, const Line &text, bool wrap)>;
+    void set_row_handler(RowFunc func) { row_handler = std::move(func); }
+
+    // Scrollback history: lines scrolled off the top of the screen, oldest first
+    int get_history_size() const;
+    const Line &get_history_line(int index) const;
+    void set_history_limit(int lines);
+    size_t drop_history(size_t bytes);
+
+    // Absolute line numbers count lines from the start of the session.
+    // Lines before first_line() were dropped from history.
+    int64_t first_line() const { return lines_scrolled - get_history_size(); }
+    int64_t screen_line(int row) const { return lines_scrolled + row; }
+    const Line *get_line(int64_t line) const;
+
+    // On resize, text is reflowed for the new width: the screen at once,
+    // history in background. Map a line number from before the last reflow.
+    int64_t reflowed_line(int64_t line) const;
+    bool is_reflow_pending() const { return reflow_job.valid(); }
+
+    // Wait for reflow of history, and put it in place.
+    void finish_reflow();
+
+    // Inline images, in order of arrival. Size of a cell in pixels
+    // is needed to lay them out.
+    const std::vector<ImagePlacement> &get_images() const { return images; }
+
+    // Memory of decoded images: placements of the same image count once.
+    // Images above the screen can be dropped, oldest first, to release memory.
+    size_t image_memory_in_use() const;
+    size_t drop_images(size_t bytes);
+    void set_cell_size(int width, int height)
+    {
+        cell_width  = width;
+        cell_height = height;
+    }
+
+    // Shell integration: find previous or next prompt, or -1 when none.
+    int64_t find_prompt(int64_t line, bool forward);
+    std::string last_command_output();
+
+    // Memory used by this session, in bytes
+    size_t memory_in_use() const { return arena.bytes_in_use(); }
+    size_t memory_reserved() const { return arena.bytes_reserved(); }
+
+    static const int default_history_limit = 10000;
+
 private:
     // Declare test cases as friends
     FRIEND_TEST(AnsiLogicTest, EscCResetsStateAndClearsScreen);
@@ -129,22 +247,144 @@ private:
     FRIEND_TEST(AnsiLogicTest, ClearScreenEsc1J);
     FRIEND_TEST(AnsiLogicTest, ClearScreenEsc2J);
     FRIEND_TEST(AnsiLogicTest, Utf8Input);
+    FRIEND_TEST(AnsiLogicTest, AsciiRunWraps);
+    FRIEND_TEST(AnsiLogicTest, MatchesReferenceModel);
+
+    // All lines and strings of the session are allocated from the arena,
+    // so it must be constructed first and destroyed last.
+    SessionArena arena;
 
     // Terminal state
     int term_cols;
     int term_rows;
-    std::vector<std::vector<Char>> text_buffer;
+    std::pmr::vector<Line> text_buffer{ &arena };
+    std::vector<bool> wrapped; // Soft-wrap flag per screen row
     Cursor cursor;
     CharAttr current_attr;
     AnsiState state;
-    std::string ansi_seq;
+    std::pmr::string ansi_seq{ &arena };
+    bool bell_pending{};
+    wchar_t last_char{}; // Repeated by REP
+    std::string responses;
+    static const size_t max_responses_length = 4096;
+
+    // Scrolling region: rows set by DECSTBM, columns by DECSLRM when enabled by DECLRMM
+    int margin_top{};
+    int margin_bottom{};
+    int margin_left{};
+    int margin_right{};
+    bool lr_margin_mode{};
+
+    // Tab stops, one bit per column; columns added by resize get a stop every 8 columns
+    std::vector<uint64_t> tab_stops;
+    int tab_stop_cols{};
+    bool scroll_damage{};
+    std::vector<ScrollDamage> scrolls;
+
+    // Cursor and rendition saved by DECSC or SCOSC; there is one screen, so one slot.
+    // Until saved, restore moves the cursor home with default rendition.
+    struct SavedCursor {
+        Cursor cursor;
+        CharAttr attr;
+    };
+    SavedCursor saved_cursor;
+
+    // Renditions pushed by XTPUSHSGR, with mask of colors to restore by XTPOPSGR
+    struct PushedStyle {
+        enum : uint8_t { FG = 1, BG = 2 };
+        CharAttr attr;
+        uint8_t mask;
+    };
+    std::vector<PushedStyle> style_stack;
+    static const size_t max_style_stack = 10;
+
+    // Scrollback history, as ring buffer
+    std::pmr::vector<Line> history{ &arena };
+    std::vector<bool> history_wrapped; // Soft-wrap flags of history lines
+    int history_first{};               // Index of the oldest line, when the ring is full
+    int history_limit{ default_history_limit };
+    int64_t lines_scrolled{}; // Total lines ever scrolled off the screen
+
+    RowFunc row_handler;
+
+    // Shell integration marks, sorted by position
+    std::pmr::vector<ShellMark> shell_marks{ &arena };
+    static const size_t max_osc_length = 4096;
+
+    // Inline images: payload is decoded while it arrives
+    std::vector<ImagePlacement> images;
+    std::unique_ptr<ImageDecoder> image_decoder;
+    int cell_width{ 8 };
+    int cell_height{ 16 };
+    static const size_t max_image_bytes = 64 << 20;
+
+    // Reflow: the tail of the text, enough to fill the screen, is laid out at once;
+    // the head above it by worker threads. Meanwhile, lines scrolled off the screen
+    // go to the history after the head, and marks and images in the head keep
+    // their old line numbers. Job is declared last, so it is waited for
+    // before anything it uses is destroyed.
+    ReflowIndex tail_index;
+    ReflowIndex head_index;
+    int64_t reflow_first{};                          // First line before reflow
+    int64_t reflow_split{};                          // Old rows in the head
+    int64_t reflow_tail_first{};                     // First line of the tail after reflow
+    int64_t reflow_room{};                           // History rows left for the head
+    int64_t reflow_dropped{};                        // Head rows above history limit
+    int reflow_ring_first{};                         // Oldest row in the ring of the head
+    std::pmr::vector<Line> reflow_source{ &arena };  // Old rows of the head, as ring
+    std::vector<bool> reflow_wraps;                  // Soft-wrap flags of the head
+    std::pmr::vector<Line> reflow_history{ &arena }; // New rows of the head
+    std::pmr::vector<ShellMark> reflow_marks{ &arena };
+    std::vector<ImagePlacement> reflow_images;
+    std::future<void> reflow_job;
 
     // ANSI colors
     static const RgbColor normal_colors[8];
     static const RgbColor bright_colors[8];
 
+    void unwrap_history();
+    void reflow(int new_cols, int new_rows);
+    void reflow_head(int old_cols, int new_cols);
+
+    // Rectangle of screen cells, inclusive, from zero
+    struct Rect {
+        int top, left, bottom, right;
+    };
+
     // ANSI parsing methods
-    void parse_ansi_sequence(const std::string &seq, std::vector<int> &dirty_rows);
+    void parse_ansi_sequence(std::string_view seq, std::vector<int> &dirty_rows);
+    void parse_rect_sequence(char final, const std::vector<int> &params,
+                             std::vector<int> &dirty_rows);
+    void parse_osc_sequence(std::string_view seq, std::vector<int> &dirty_rows);
+    void respond(std::string_view reply);
+    Rect get_rect(const std::vector<int> &params, size_t index) const;
+    void copy_rect(const Rect &src, int dst_row, int dst_col, std::vector<int> &dirty_rows);
+    void fill_rect(const Rect &rect, const Char &fill, bool selective,
+                   std::vector<int> &dirty_rows);
+    void place_image(std::shared_ptr<InlineImage> image, std::string_view args,
+                     std::vector<int> &dirty_rows);
+    int image_extent(std::string_view args, std::string_view key, int screen_cells,
+                     int cell_pixels) const;
+    void add_shell_mark(char kind);
+    void end_row(bool wrap);
+    void next_row(bool wrap, std::vector<int> &dirty_rows);
+    void reverse_index(std::vector<int> &dirty_rows);
+    void reset_margins();
+    bool in_margins() const;
+    bool in_column_margins() const;
+    void resize_tab_stops();
+    int next_tab_stop(int col) const;
+    int prev_tab_stop(int col) const;
+    Rect scroll_region() const { return { margin_top, margin_left, margin_bottom, margin_right }; }
+    void scroll_rect(const Rect &rect, int count, std::vector<int> &dirty_rows);
+    void put_char(wchar_t ch, std::vector<int> &dirty_rows);
+    void wrap_row(bool inside, std::vector<int> &dirty_rows);
+    void carriage_return();
+    void save_cursor();
+    void restore_cursor();
+    void push_style(const std::vector<int> &params);
+    void pop_style();
+    void put_ascii_run(const char *text, size_t count, std::vector<int> &dirty_rows);
 
     // Terminal management methods
     void clear_screen();
@@ -0,0 +1,88 @@
+//
+// Generators of typical terminal output, for benchmarks.
+//
+// Copyright (c) 2025 Serge Vakulenko
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include "bench_corpus.h"
+
+#include <random>
+
+std::string gen_ascii(size_t size)
+{
+    std::mt19937 rng(1);
+    std::string out;
+    while (out.size() < size) {
+        for (unsigned n = 10 + rng() % 70; n > 0; --n) {
+            out += static_cast<char>(' ' + rng() % 95);
+        }
+        out += "\r\n";
+    }
+    return out;
+}
+
+std::string gen_colors(size_t size)
+{
+    static const char *const levels[] = { "\033[32mINFO\033[0m ", "\033[33mWARN\033[0m ",
+                                          "\033[1;31mERROR\033[0m ", "\033[36mDEBUG\033[0m " };
+    std::mt19937 rng(2);
+    std::string out;
+    while (out.size() < size) {
+        out += "\033[90m2025-01-01 12:00:00\033[0m ";
+        out += levels[rng() % 4];
+        for (unsigned n = 10 + rng() % 50; n > 0; --n) {
+            out += static_cast<char>('a' + rng() % 26);
+        }
+        out += "\r\n";
+    }
+    return out;
+}
+
+std::string gen_redraw(size_t size)
+{
+    std::mt19937 rng(3);
+    std::string out;
+    while (out.size() < size) {
+        out += "\033[H\033[2J";
+        for (int row = 1; row <= 24; ++row) {
+            out += "\033[" + std::to_string(row) + ";1H\033[" + std::to_string(40 + row % 8) + "m";
+            for (int n = 0; n < 80; ++n) {
+                out += static_cast<char>(' ' + rng() % 95);
+            }
+        }
+        out += "\033[0m";
+    }
+    return out;
+}
+
+std::string gen_utf8(size_t size)
+{
+    static const char *const words[] = { "\xD0\x9F\xD1\x80\xD0\xB8\xD0\xB2\xD0\xB5\xD1\x82 ",
+                                         "\xE4\xB8\xAD\xE6\x96\x87 ", "caf\xC3\xA9 ", "text " };
+    std::mt19937 rng(4);
+    std::string out;
+    while (out.size() < size) {
+        for (unsigned n = 3 + rng() % 10; n > 0; --n) {
+            out += words[rng() % 4];
+        }
+        out += "\r\n";
+    }
+    return out;
+}
@@ -0,0 +1,39 @@
+//
+// Generators of typical terminal output, for benchmarks.
+//
+// Copyright (c) 2025 Serge Vakulenko
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef BENCH_CORPUS_H
+#define BENCH_CORPUS_H
+
+#include <cstddef>
+#include <string>
+
+//
+// Every generator returns about the given number of bytes,
+// the same on every run. Lines end with CR LF, as after the tty driver.
+//
+std::string gen_ascii(size_t size);  // Random printable text
+std::string gen_colors(size_t size); // Log lines with colored timestamps and levels
+std::string gen_redraw(size_t size); // Full-screen updates by cursor addressing
+std::string gen_utf8(size_t size);   // Multibyte text
+
+#endif // BENCH_CORPUS_H
@@ -0,0 +1,114 @@
+//
+// Parser benchmark for the terminal emulator.
+//
+// Copyright (c) 2025 Serge Vakulenko
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <string>
+
+#include "ansi_logic.h"
+#include "bench_corpus.h"
+#include "perf_counters.h"
+#include "simd_scan.h"
+
+//
+// Feed the corpus through the parser in PTY-sized chunks, and report results.
+//
+static void run_workload(const char *name, const std::string &corpus, PerfCounters &perf)
+{
+    AnsiLogic logic(80, 24);
+    const size_t chunk = 1024;
+
+    perf.start();
+    auto start = std::chrono::steady_clock::now();
+    for (size_t pos = 0; pos < corpus.size(); pos += chunk) {
+        logic.process_input(&corpus[pos], std::min(chunk, corpus.size() - pos));
+    }
+    auto stop = std::chrono::steady_clock::now();
+    perf.stop();
+
+    double seconds = std::chrono::duration<double>(stop - start).count();
+    double bytes   = corpus.size();
+    std::printf("%-8s %9.1f MB/s %8.2f ns/byte", name, bytes / seconds / 1e6,
+                seconds * 1e9 / bytes);
+    for (int e = 0; e < PerfCounters::NUM_EVENTS; ++e) {
+        uint64_t value;
+        if (perf.get(PerfCounters::Event(e), value)) {
+            std::printf("  %.3f %s/byte", value / bytes,
+                        PerfCounters::name(PerfCounters::Event(e)));
+        }
+    }
+    std::printf("\n");
+}
+
+static void usage()
+{
+    std::cerr << "Usage: benchmark [--perf] [--size MB] [--kernel NAME]\n";
+    std::cerr << "  --perf         Report hardware counters per byte parsed\n";
+    std::cerr << "  --size MB      Amount of data per workload, default 16\n";
+    std::cerr << "  --kernel NAME  Force SIMD kernel set: scalar, sse2, avx2, avx512 or neon\n";
+    std::exit(1);
+}
+
+int main(int argc, char **argv)
+{
+    bool use_perf = false;
+    size_t size   = 16;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--perf") == 0) {
+            use_perf = true;
+        } else if (std::strcmp(argv[i], "--size") == 0 && i + 1 < argc) {
+            size = std::atoi(argv[++i]);
+        } else if (std::strcmp(argv[i], "--kernel") == 0 && i + 1 < argc) {
+            if (!simd::select_kernel(argv[++i])) {
+                std::cerr << "Kernel " << argv[i] << " is not supported by this CPU\n";
+                return 1;
+            }
+        } else {
+            usage();
+        }
+    }
+
+    PerfCounters perf;
+    if (use_perf && !perf.open()) {
+        std::cerr << "Hardware counters are not available, check perf_event_paranoid\n";
+    }
+    std::printf("SIMD kernel: %s\n", simd::kernel_name());
+
+    const struct {
+        const char *name;
+        std::function<std::string(size_t)> generate;
+    } workloads[] = {
+        { "ascii", gen_ascii },
+        { "colors", gen_colors },
+        { "redraw", gen_redraw },
+        { "utf8", gen_utf8 },
+    };
+    for (const auto &w : workloads) {
+        run_workload(w.name, w.generate(size << 20), perf);
+    }
+    return 0;
+}
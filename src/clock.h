@@ -0,0 +1,73 @@
+//
+// Source of time, replaceable in tests.
+//
+// Copyright (c) 2025 Serge Vakulenko
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef CLOCK_H
+#define CLOCK_H
+
+#include <chrono>
+#include <cstdint>
+
+//
+// Monotonic time in milliseconds.
+// Everything time-dependent takes the clock as a reference,
+// so tests can substitute a virtual clock and control time.
+//
+class Clock {
+public:
+    virtual ~Clock() = default;
+
+    virtual uint64_t now_ms() const = 0;
+
+    // Real time, shared by everyone.
+    static Clock &system();
+};
+
+class SteadyClock : public Clock {
+public:
+    uint64_t now_ms() const override
+    {
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        return std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count();
+    }
+
+private:
+    std::chrono::steady_clock::time_point start{ std::chrono::steady_clock::now() };
+};
+
+// Time moves only when told to.
+class VirtualClock : public Clock {
+public:
+    uint64_t now_ms() const override { return time; }
+    void advance(uint64_t ms) { time += ms; }
+
+private:
+    uint64_t time{ 1000 };
+};
+
+inline Clock &Clock::system()
+{
+    static SteadyClock clock;
+    return clock;
+}
+
+#endif // CLOCK_H
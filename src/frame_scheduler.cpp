@@ -0,0 +1,99 @@
+//
+// Timing decisions of the main loop.
+//
+// Copyright (c) 2025 Serge Vakulenko
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include "frame_scheduler.h"
+
+void FrameScheduler::activity()
+{
+    last_activity = clock.now_ms();
+}
+
+void FrameScheduler::key_pressed()
+{
+    last_activity = clock.now_ms();
+    input_pending = true;
+}
+
+void FrameScheduler::frame_presented()
+{
+    last_frame    = clock.now_ms();
+    input_pending = false;
+}
+
+bool FrameScheduler::update_blink()
+{
+    uint64_t now = clock.now_ms();
+    if (now - last_activity < cursor_blink_interval) {
+        // Typing or output: keep cursor steady.
+        last_cursor_toggle = now;
+        if (!cursor_visible) {
+            cursor_visible = true;
+            return true;
+        }
+        return false;
+    }
+    if (now - last_cursor_toggle >= cursor_blink_interval) {
+        cursor_visible     = !cursor_visible;
+        last_cursor_toggle = now;
+        return true;
+    }
+    return false;
+}
+
+bool FrameScheduler::ring_bell()
+{
+    uint64_t now = clock.now_ms();
+    if (bell_rang && now - last_bell < bell_cooldown)
+        return false;
+    bell_rang    = true;
+    last_bell    = now;
+    bell_visible = true;
+    return true;
+}
+
+bool FrameScheduler::update_bell()
+{
+    if (bell_visible && clock.now_ms() - last_bell >= bell_flash_duration) {
+        bell_visible = false;
+        return true;
+    }
+    return false;
+}
+
+void FrameScheduler::request_resize(int cols, int rows)
+{
+    resize_requested = clock.now_ms();
+    resize_pending   = true;
+    resize_cols      = cols;
+    resize_rows      = rows;
+}
+
+bool FrameScheduler::take_resize(int &cols, int &rows)
+{
+    if (!resize_pending || clock.now_ms() - resize_requested < resize_delay)
+        return false;
+    resize_pending = false;
+    cols           = resize_cols;
+    rows           = resize_rows;
+    return true;
+}
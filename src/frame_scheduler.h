@@ -0,0 +1,98 @@
+//
+// Timing decisions of the main loop.
+//
+// Copyright (c) 2025 Serge Vakulenko
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef FRAME_SCHEDULER_H
+#define FRAME_SCHEDULER_H
+
+#include <cstdint>
+
+#include "clock.h"
+
+//
+// All timing of the terminal: frame pacing, cursor blink, bell,
+// resize debouncing, idle detection and parsing time slices.
+// It has no SDL dependency, and takes time from the given clock.
+//
+class FrameScheduler {
+public:
+    explicit FrameScheduler(Clock &c) : clock(c) {}
+
+    // Key press or output from the child.
+    void activity();
+    bool is_idle() const { return clock.now_ms() - last_activity >= idle_trim_delay; }
+
+    // Key press: echo of the key is presented at once, without waiting for the frame interval.
+    void key_pressed();
+    bool is_input_pending() const { return input_pending; }
+
+    // Frames are coalesced: at most one per frame interval, unless input is pending.
+    bool can_present() const
+    {
+        return input_pending || clock.now_ms() - last_frame >= frame_interval;
+    }
+    void frame_presented();
+
+    // Cursor blinks, but stays visible while there is activity.
+    // Return true when visibility has changed.
+    bool update_blink();
+    bool is_cursor_visible() const { return cursor_visible; }
+
+    // Bell: return false when it rang recently.
+    bool ring_bell();
+    bool is_bell_visible() const { return bell_visible; }
+    bool update_bell(); // Return true when flash has ended
+
+    // Window size settles before the terminal is resized.
+    void request_resize(int cols, int rows);
+    bool take_resize(int &cols, int &rows);
+
+    // Output is parsed in time slices, so frames keep coming under heavy output.
+    void start_slice() { slice_start = clock.now_ms(); }
+    bool slice_expired() const { return clock.now_ms() - slice_start >= parse_slice; }
+
+    static const uint64_t frame_interval        = 16;    // About 60 frames per second
+    static const uint64_t cursor_blink_interval = 500;   // Half period of blink
+    static const uint64_t bell_flash_duration   = 100;   // Visible flash
+    static const uint64_t bell_cooldown         = 250;   // Bells are ignored after a bell
+    static const uint64_t resize_delay          = 100;   // Window size must stay for this time
+    static const uint64_t parse_slice           = 8;     // Parsing time before a frame
+    static const uint64_t idle_trim_delay       = 30000; // Release memory after idle time
+
+private:
+    Clock &clock;
+    uint64_t last_activity{ clock.now_ms() };
+    uint64_t last_frame{};
+    bool input_pending{};
+    uint64_t last_cursor_toggle{ clock.now_ms() };
+    bool cursor_visible{ true };
+    uint64_t last_bell{};
+    bool bell_rang{};
+    bool bell_visible{};
+    uint64_t resize_requested{};
+    bool resize_pending{};
+    int resize_cols{};
+    int resize_rows{};
+    uint64_t slice_start{};
+};
+
+#endif // FRAME_SCHEDULER_H
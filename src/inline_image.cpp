@@ -0,0 +1,206 @@
+//
+// Inline images: streaming decoder for OSC 1337 payloads.
+//
+// Copyright (c) 2025 Serge Vakulenko
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include "inline_image.h"
+
+#include "png_reader.h"
+#include "simd_scan.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+
+void ImageDecoder::feed_base64(const char *text, size_t length)
+{
+    uint8_t buffer[3072];
+    while (length > 0 && !error) {
+        if (group_size == 0) {
+            size_t count = simd::decode_base64(text, std::min<size_t>(length, 4096), buffer);
+            if (count > 0) {
+                feed(buffer, count / 4 * 3);
+                text += count;
+                length -= count;
+                continue;
+            }
+        }
+
+        // Slow path: group split between chunks, padding or line break.
+        char c = *text++;
+        length--;
+        int value = simd::base64_value(c);
+        if (value >= 0) {
+            group[group_size++] = value;
+            if (group_size == 4) {
+                flush_group();
+            }
+        } else if (c == '=') {
+            flush_group();
+        }
+    }
+}
+
+//
+// Decode incomplete group of characters, at padding or at the end.
+//
+void ImageDecoder::flush_group()
+{
+    if (group_size >= 2) {
+        std::fill(group + group_size, group + 4, 0);
+        uint32_t v     = (group[0] << 18) | (group[1] << 12) | (group[2] << 6) | group[3];
+        uint8_t out[3] = { uint8_t(v >> 16), uint8_t(v >> 8), uint8_t(v) };
+        feed(out, group_size - 1);
+    }
+    group_size = 0;
+}
+
+std::shared_ptr<InlineImage> ImageDecoder::finish()
+{
+    flush_group();
+    if (png && !error) {
+        image = std::make_shared<InlineImage>();
+        if (!decode_png(png_file.data(), png_file.size(), limit, image->width, image->height,
+                        image->pixels) ||
+            image->width > max_side || image->height > max_side) {
+            error = true;
+        }
+        rows_done = image->height;
+        png_file  = std::vector<uint8_t>();
+    }
+    if (error || !image || rows_done < image->height)
+        return nullptr;
+    image->hash = hash;
+    return std::move(image);
+}
+
+//
+// Take bytes of the file: header first, then rows of pixels.
+// PNG is recognized by its signature, and collected.
+//
+void ImageDecoder::feed(const uint8_t *data, size_t length)
+{
+    if (error)
+        return;
+    received += length;
+    if (received > limit) {
+        error = true;
+        return;
+    }
+    for (size_t i = 0; i < length; ++i) {
+        hash = (hash ^ data[i]) * 1099511628211ull;
+    }
+
+    while (length > 0) {
+        size_t count;
+        if (png) {
+            png_file.insert(png_file.end(), data, data + length);
+            return;
+        }
+        if (!image || header.size() < data_offset) {
+            size_t need = image ? data_offset : (header.size() < 8) ? 8 : 54;
+            count       = std::min(length, need - header.size());
+            header.insert(header.end(), data, data + count);
+            if (!image && header.size() == 8 && std::memcmp(header.data(), "\x89PNG", 4) == 0) {
+                png = true;
+                png_file.swap(header);
+            } else if (!image && header.size() == 54) {
+                parse_header();
+                if (error)
+                    return;
+            }
+        } else if (rows_done < image->height) {
+            count = std::min(length, row_size - row.size());
+            row.insert(row.end(), data, data + count);
+            if (row.size() == row_size) {
+                put_row();
+            }
+        } else {
+            // Bytes after the last row are ignored.
+            return;
+        }
+        data += count;
+        length -= count;
+    }
+}
+
+//
+// Check file header and info header, and allocate the image.
+// For 32-bit pixels with bit fields, the masks are assumed to be the usual BGRA.
+//
+void ImageDecoder::parse_header()
+{
+    auto get16 = [this](int offset) { return header[offset] | (header[offset + 1] << 8); };
+    auto get32 = [this](int offset) {
+        return static_cast<int32_t>(header[offset] | (header[offset + 1] << 8) |
+                                    (header[offset + 2] << 16) |
+                                    (static_cast<uint32_t>(header[offset + 3]) << 24));
+    };
+    int info_size   = get32(14);
+    int width       = get32(18);
+    int height      = get32(22);
+    int compression = get32(30);
+    bits            = get16(28);
+    data_offset     = static_cast<uint32_t>(get32(10));
+    top_down        = height < 0;
+    has_alpha       = (compression == 3);
+    if (height == std::numeric_limits<int32_t>::min()) {
+        error = true; // Can't be negated
+        return;
+    }
+    height = std::abs(height);
+
+    if (header[0] != 'B' || header[1] != 'M' || info_size < 40 ||
+        data_offset < 14 + static_cast<size_t>(info_size) || data_offset > max_header ||
+        !((bits == 24 && compression == 0) || (bits == 32 && (compression == 0 || has_alpha))) ||
+        width <= 0 || height <= 0 || width > max_side || height > max_side ||
+        static_cast<size_t>(width) * height * 4 > limit) {
+        error = true;
+        return;
+    }
+    image         = std::make_shared<InlineImage>();
+    image->width  = width;
+    image->height = height;
+    image->pixels.resize(static_cast<size_t>(width) * height * 4);
+    row_size = (static_cast<size_t>(width) * bits / 8 + 3) & ~size_t(3);
+    row.reserve(row_size);
+}
+
+//
+// Convert a row of BGR or BGRA pixels. Rows are stored bottom up, unless height is negative.
+//
+void ImageDecoder::put_row()
+{
+    int y        = top_down ? rows_done : image->height - 1 - rows_done;
+    uint8_t *out = &image->pixels[static_cast<size_t>(y) * image->width * 4];
+    int step     = bits / 8;
+    for (int x = 0; x < image->width; ++x) {
+        const uint8_t *in = &row[x * step];
+        out[0]            = in[2];
+        out[1]            = in[1];
+        out[2]            = in[0];
+        out[3]            = has_alpha ? in[3] : 255;
+        out += 4;
+    }
+    rows_done++;
+    row.clear();
+}
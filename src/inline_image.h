@@ -0,0 +1,99 @@
+//
+// Inline images: streaming decoder for OSC 1337 payloads.
+//
+// Copyright (c) 2025 Serge Vakulenko
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef INLINE_IMAGE_H
+#define INLINE_IMAGE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+//
+// Image received by OSC 1337 (iTerm2 inline image protocol).
+//
+struct InlineImage {
+    uint64_t hash;               // Of the file contents
+    int width;                   // In pixels
+    int height;
+    std::vector<uint8_t> pixels; // RGBA, top row first
+};
+
+//
+// Decode an image while it arrives: base64 text is decoded in blocks
+// by SIMD kernels. Uncompressed BMP, with 24 or 32 bits per pixel,
+// is converted row by row as soon as rows are complete, without collecting
+// the payload. PNG is collected, and decoded when complete.
+//
+class ImageDecoder {
+public:
+    // Files larger than the limit, or with more pixel data, are rejected.
+    explicit ImageDecoder(size_t max_bytes) : limit(max_bytes) {}
+
+    void feed_base64(const char *text, size_t length);
+
+    // Image, when it's complete and valid; otherwise null.
+    std::shared_ptr<InlineImage> finish();
+
+    bool failed() const { return error; }
+
+    // Memory held while decoding, in bytes
+    size_t memory_in_use() const
+    {
+        return header.capacity() + row.capacity() + png_file.capacity() +
+               (image ? image->pixels.capacity() : 0);
+    }
+
+private:
+    size_t limit;
+    bool error{};
+    size_t received{};                        // Bytes of the file so far
+    uint64_t hash{ 14695981039346656037ull }; // FNV-1a
+    uint8_t group[4];                         // Incomplete group of base64 characters
+    int group_size{};
+
+    // BMP file
+    std::vector<uint8_t> header; // Up to pixel data
+    size_t data_offset{};
+    int bits{};
+    bool top_down{};
+    bool has_alpha{};
+    std::vector<uint8_t> row;    // Incomplete row of pixels
+    size_t row_size{};
+    int rows_done{};
+    std::shared_ptr<InlineImage> image;
+
+    // PNG file
+    bool png{};
+    std::vector<uint8_t> png_file;
+
+    static const size_t max_header = 4096;
+    static const int max_side      = 16384;
+
+    void flush_group();
+    void feed(const uint8_t *data, size_t length);
+    void parse_header();
+    void put_row();
+};
+
+#endif // INLINE_IMAGE_H
@@ -0,0 +1,226 @@
+//
+// Detection of URLs and file paths in screen text.
+//
+// Copyright (c) 2025 Serge Vakulenko
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include "link_detector.h"
+
+#include <algorithm>
+#include <cwchar>
+#include <cwctype>
+
+static std::string wstring_to_utf8(const std::wstring &wstr)
+{
+    std::string utf8;
+    for (wchar_t wc : wstr) {
+        if (wc <= 0x7F) {
+            utf8 += static_cast<char>(wc);
+        } else if (wc <= 0x7FF) {
+            utf8 += static_cast<char>(0xC0 | ((wc >> 6) & 0x1F));
+            utf8 += static_cast<char>(0x80 | (wc & 0x3F));
+        } else if (wc <= 0xFFFF) {
+            utf8 += static_cast<char>(0xE0 | ((wc >> 12) & 0x0F));
+            utf8 += static_cast<char>(0x80 | ((wc >> 6) & 0x3F));
+            utf8 += static_cast<char>(0x80 | (wc & 0x3F));
+        } else {
+            utf8 += static_cast<char>(0xF0 | ((wc >> 18) & 0x07));
+            utf8 += static_cast<char>(0x80 | ((wc >> 12) & 0x3F));
+            utf8 += static_cast<char>(0x80 | ((wc >> 6) & 0x3F));
+            utf8 += static_cast<char>(0x80 | (wc & 0x3F));
+        }
+    }
+    return utf8;
+}
+
+static bool is_scheme_char(wchar_t c)
+{
+    return (c < 0x80 && std::iswalnum(c)) || c == L'+' || c == L'-' || c == L'.';
+}
+
+static bool is_url_char(wchar_t c)
+{
+    return c > L' ' && c != 0x7f && !std::wcschr(L"<>\"'`{}|\\^", c);
+}
+
+static bool is_path_char(wchar_t c)
+{
+    return std::iswalnum(c) || std::wcschr(L"._-/~+@%#", c);
+}
+
+// Token starts here: at line start, after a blank or an opening delimiter.
+static bool at_word_start(const std::wstring &text, size_t pos)
+{
+    return pos == 0 || std::wcschr(L" \t([<\"'=", text[pos - 1]);
+}
+
+//
+// Drop trailing punctuation, which usually belongs to the sentence.
+// Closing parenthesis is kept when it has a pair inside the link.
+//
+static size_t trim_link_end(const std::wstring &text, size_t start, size_t end)
+{
+    while (end > start) {
+        wchar_t c = text[end - 1];
+        if (c == L')') {
+            auto open  = std::count(text.begin() + start, text.begin() + end, L'(');
+            auto close = std::count(text.begin() + start, text.begin() + end, L')');
+            if (open >= close)
+                break;
+        } else if (!std::wcschr(L".,;:!?]}'\"", c)) {
+            break;
+        }
+        --end;
+    }
+    return end;
+}
+
+//
+// Find URLs (scheme://..., www....) and file paths (/..., ~/..., ./..., ../...).
+// Only characters which may start a link are visited by the scan.
+//
+std::vector<LinkDetector::Match> LinkDetector::scan(const std::wstring &text)
+{
+    std::vector<Match> matches;
+    size_t pos = 0;
+    while ((pos = text.find_first_of(L":w/~.", pos)) != std::wstring::npos) {
+        size_t start = pos;
+        size_t end;
+        const char *prefix = "";
+        if (text.compare(pos, 3, L"://") == 0) {
+            while (start > 0 && is_scheme_char(text[start - 1])) {
+                --start;
+            }
+            end = pos + 3;
+            while (end < text.size() && is_url_char(text[end])) {
+                ++end;
+            }
+            if (start == pos || !std::iswalpha(text[start]) || end == pos + 3) {
+                pos += 3;
+                continue;
+            }
+        } else if (text.compare(pos, 4, L"www.") == 0 && at_word_start(text, pos)) {
+            end = pos + 4;
+            while (end < text.size() && is_url_char(text[end])) {
+                ++end;
+            }
+            prefix = "http://";
+        } else if (at_word_start(text, pos) &&
+                   ((text[pos] == L'/' && pos + 1 < text.size() && text[pos + 1] != L'/' &&
+                     is_path_char(text[pos + 1])) ||
+                    text.compare(pos, 2, L"~/") == 0 || text.compare(pos, 2, L"./") == 0 ||
+                    text.compare(pos, 3, L"../") == 0)) {
+            end = pos + 1;
+            while (end < text.size() && is_path_char(text[end])) {
+                ++end;
+            }
+        } else {
+            ++pos;
+            continue;
+        }
+
+        end = trim_link_end(text, start, end);
+        if (end > start + 1) {
+            std::string target = prefix + wstring_to_utf8(text.substr(start, end - start));
+            matches.push_back({ start, end, target });
+        }
+        pos = std::max(end, pos + 1);
+    }
+    return matches;
+}
+
+void LinkDetector::resize(int rows)
+{
+    generation.assign(rows, 1);
+    scanned_generation.assign(rows, 0);
+    row_links.assign(rows, {});
+}
+
+void LinkDetector::invalidate(int row)
+{
+    if (row >= 0 && row < static_cast<int>(generation.size())) {
+        generation[row]++;
+    }
+}
+
+void LinkDetector::invalidate_all()
+{
+    for (auto &g : generation) {
+        g++;
+    }
+}
+
+void LinkDetector::update(const AnsiLogic &display)
+{
+    const int rows = display.get_rows();
+    const int cols = display.get_cols();
+    if (static_cast<int>(generation.size()) != rows) {
+        resize(rows);
+    }
+
+    const auto &text_buffer = display.get_text_buffer();
+    for (int row = 0; row < rows;) {
+        // Logical line: rows joined by soft wraps.
+        int first = row;
+        int last  = row;
+        while (last + 1 < rows && display.is_wrapped(last)) {
+            ++last;
+        }
+        row = last + 1;
+
+        bool stale = false;
+        for (int r = first; r <= last; ++r) {
+            stale |= (scanned_generation[r] != generation[r]);
+        }
+        if (!stale)
+            continue;
+
+        std::wstring text;
+        for (int r = first; r <= last; ++r) {
+            for (const auto &c : text_buffer[r]) {
+                text += c.ch;
+            }
+            row_links[r].clear();
+            scanned_generation[r] = generation[r];
+        }
+        rows_scanned += last - first + 1;
+
+        for (auto &m : scan(text)) {
+            Link link{ first + static_cast<int>(m.start / cols), static_cast<int>(m.start % cols),
+                       first + static_cast<int>((m.end - 1) / cols),
+                       static_cast<int>((m.end - 1) % cols), m.target };
+            for (int r = link.row; r <= link.end_row; ++r) {
+                row_links[r].push_back(link);
+            }
+        }
+    }
+}
+
+const Link *LinkDetector::find(int row, int col) const
+{
+    if (row < 0 || row >= static_cast<int>(row_links.size()))
+        return nullptr;
+
+    for (const auto &link : row_links[row]) {
+        if (link.contains(row, col))
+            return &link;
+    }
+    return nullptr;
+}
@@ -0,0 +1,81 @@
+//
+// Detection of URLs and file paths in screen text.
+//
+// Copyright (c) 2025 Serge Vakulenko
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef LINK_DETECTOR_H
+#define LINK_DETECTOR_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "ansi_logic.h"
+
+// Link found on the screen: URL or file path.
+// It may continue over soft-wrapped rows.
+struct Link {
+    int row, col;         // First character
+    int end_row, end_col; // Last character, inclusive
+    std::string target;   // In UTF-8, ready to open
+
+    bool contains(int r, int c) const
+    {
+        return (r > row || (r == row && c >= col)) &&
+               (r < end_row || (r == end_row && c <= end_col));
+    }
+};
+
+//
+// Links are detected only on rows which have changed since the last scan.
+// Every row has a generation counter; results are cached per generation,
+// so hover and click lookups never touch the text grid.
+//
+class LinkDetector {
+public:
+    void resize(int rows);
+    void invalidate(int row);
+    void invalidate_all();
+
+    // Rescan changed rows, together with rows they are wrapped with.
+    void update(const AnsiLogic &display);
+
+    // Link under given cell, or nullptr.
+    const Link *find(int row, int col) const;
+
+    uint64_t get_generation(int row) const { return generation[row]; }
+    uint64_t get_rows_scanned() const { return rows_scanned; }
+
+    // Find links in text of one logical line; positions are indices in the text.
+    struct Match {
+        size_t start, end; // Range [start, end)
+        std::string target;
+    };
+    static std::vector<Match> scan(const std::wstring &text);
+
+private:
+    std::vector<uint64_t> generation;         // Bumped when row changes
+    std::vector<uint64_t> scanned_generation; // Generation of cached results
+    std::vector<std::vector<Link>> row_links; // Links touching every row
+    uint64_t rows_scanned{};                  // Statistics, for tests
+};
+
+#endif // LINK_DETECTOR_H
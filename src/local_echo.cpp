@@ -0,0 +1,108 @@
+//
+// Predictive local echo of typed characters.
+//
+// Copyright (c) 2025 Serge Vakulenko
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include "local_echo.h"
+
+bool LocalEcho::key_typed(wchar_t ch, const AnsiLogic &display)
+{
+    if (mode == Mode::NEVER || blocked)
+        return false;
+
+    // Next to the last prediction, or at the cursor.
+    // Wrap at the right margin is not predicted.
+    int64_t line;
+    int col;
+    if (predictions.empty()) {
+        line = display.screen_line(display.get_cursor().row);
+        col  = display.get_cursor().col;
+    } else {
+        line = predictions.back().line;
+        col  = predictions.back().col + 1;
+    }
+    if (col >= display.get_cols() - 1) {
+        blocked = true;
+        return false;
+    }
+
+    predictions.push_back({ line, col, ch, clock.now_ms() });
+    return is_visible();
+}
+
+void LocalEcho::key_other()
+{
+    blocked = true;
+}
+
+bool LocalEcho::validate(const AnsiLogic &display)
+{
+    bool was_visible = is_visible() && !predictions.empty();
+    size_t count     = predictions.size();
+    blocked          = false;
+
+    const Cursor &cursor = display.get_cursor();
+    int64_t cursor_line  = display.screen_line(cursor.row);
+    uint64_t now         = clock.now_ms();
+    while (!predictions.empty()) {
+        const Prediction &p = predictions.front();
+        bool passed = cursor_line > p.line || (cursor_line == p.line && cursor.col > p.col);
+        if (!passed) {
+            if (now - p.time >= prediction_timeout) {
+                rollback();
+            }
+            break;
+        }
+
+        const Line *text = display.get_line(p.line);
+        if (!text || p.col >= static_cast<int>(text->size()) || (*text)[p.col].ch != p.ch) {
+            rollback();
+            break;
+        }
+
+        // Confirmed: update latency, smoothed as round-trip time in TCP.
+        uint64_t sample = now - p.time;
+        latency         = (latency == 0) ? sample : (latency * 7 + sample) / 8;
+        tentative       = false;
+        predictions.erase(predictions.begin());
+    }
+    bool now_visible = is_visible() && !predictions.empty();
+    return was_visible != now_visible || (was_visible && predictions.size() != count);
+}
+
+bool LocalEcho::is_visible() const
+{
+    switch (mode) {
+    case Mode::ALWAYS:
+        return !tentative;
+    case Mode::ADAPTIVE:
+        return !tentative && latency >= show_latency;
+    default:
+        return false;
+    }
+}
+
+void LocalEcho::rollback()
+{
+    predictions.clear();
+    tentative = true;
+    mispredictions++;
+}
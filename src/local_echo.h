@@ -0,0 +1,91 @@
+//
+// Predictive local echo of typed characters.
+//
+// Copyright (c) 2025 Serge Vakulenko
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef LOCAL_ECHO_H
+#define LOCAL_ECHO_H
+
+#include <cstdint>
+#include <vector>
+
+#include "ansi_logic.h"
+#include "clock.h"
+
+// Character drawn before its echo arrives, at absolute line number
+struct Prediction {
+    int64_t line;
+    int col;
+    wchar_t ch;
+    uint64_t time; // When the key was typed
+};
+
+//
+// Typed characters are predicted to appear at the cursor, and drawn at once
+// as an overlay. When output moves the cursor past a prediction, the screen
+// confirms it or not: one wrong guess rolls back all pending predictions.
+// Echo latency is measured on confirmations; in adaptive mode predictions
+// are shown only when it's high. After a wrong guess, predictions stay
+// hidden until one is confirmed again, so full-screen applications
+// which don't echo keys are not disturbed.
+//
+class LocalEcho {
+public:
+    enum class Mode { NEVER, ADAPTIVE, ALWAYS };
+
+    explicit LocalEcho(Clock &c) : clock(c) {}
+    void set_mode(Mode m) { mode = m; }
+
+    // Printable character sent to the child.
+    // Return true when a prediction was made.
+    bool key_typed(wchar_t ch, const AnsiLogic &display);
+
+    // Any other key: position of further echo is unknown,
+    // so nothing is predicted until the output settles.
+    void key_other();
+
+    // Check predictions against the screen, after output was processed.
+    // Return true when visible overlay has changed.
+    bool validate(const AnsiLogic &display);
+
+    // Overlay to draw: empty when predictions are not shown.
+    bool is_visible() const;
+    const std::vector<Prediction> &get_predictions() const { return predictions; }
+
+    uint64_t get_latency() const { return latency; }
+    uint64_t get_mispredictions() const { return mispredictions; }
+
+    static const uint64_t show_latency       = 30;   // Adaptive mode: show above this, msec
+    static const uint64_t prediction_timeout = 2000; // Drop predictions without echo
+
+private:
+    Clock &clock;
+    Mode mode{ Mode::ADAPTIVE };
+    std::vector<Prediction> predictions; // Oldest first
+    bool tentative{};                    // Wrong guess recently: don't show
+    bool blocked{};                      // Other key typed: wait for output
+    uint64_t latency{};                  // Smoothed echo latency, msec
+    uint64_t mispredictions{};
+
+    void rollback();
+};
+
+#endif // LOCAL_ECHO_H
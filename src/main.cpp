@@ -21,14 +21,131 @@
 // OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 // SOFTWARE.
 //
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "bench_corpus.h"
+#include "memory_governor.h"
+#include "screenshot.h"
 #include "sdl_terminal.h"
 
-int main()
+static void usage()
+{
+    std::cerr << "Usage: terminal_emulator [options]\n";
+    std::cerr << "       terminal_emulator --screenshot DIR [screenshot options] [FILE...]\n";
+    std::cerr << "Options:\n";
+    std::cerr << "  --verbose            Report memory released when idle, and triggers matched\n";
+    std::cerr << "  --memory-budget MB   Limit total memory for scrollback and caches\n";
+    std::cerr << "  --audible-bell       Beep on bell, besides flashing the window\n";
+    std::cerr << "  --trigger PATTERN    Highlight lines of output containing the pattern\n";
+    std::cerr << "  --local-echo MODE    Predict echo of typed keys: never, adaptive (default)\n";
+    std::cerr << "                       or always\n";
+    std::cerr << "  --delay-ms MSEC      Delay output of the child, like a slow link\n";
+    std::cerr << "  --idle-test SECONDS  Measure wakeups and CPU time when idle, then exit\n";
+    std::cerr << "  --bench              Measure throughput of generated output, then exit\n";
+    std::cerr << "  --perf               With --bench, report hardware counters per frame\n";
+    std::cerr << "Screenshot options:\n";
+    std::cerr << "  --geometry COLSxROWS Size of the screen, default 80x24\n";
+    std::cerr << "  --at OFFSET          Save also a frame after this many bytes of output\n";
+    std::cerr << "  --exec COMMAND       Run command, and save a frame of its output\n";
+    std::cerr << "Files are recordings of terminal output, replayed to save frames as PNG.\n";
+    std::exit(1);
+}
+
+int main(int argc, char **argv)
 {
+    unsigned idle_test_seconds = 0;
+    bool bench                 = false;
+    bool bench_perf            = false;
+    bool verbose               = false;
+    bool audible_bell          = false;
+    unsigned output_delay      = 0;
+    auto local_echo            = LocalEcho::Mode::ADAPTIVE;
+    std::vector<std::string> triggers;
+    bool screenshot_mode = false;
+    ScreenshotOptions screenshots;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--verbose") == 0) {
+            verbose = true;
+        } else if (std::strcmp(argv[i], "--memory-budget") == 0 && i + 1 < argc) {
+            MemoryGovernor::instance().set_budget(size_t(std::atoi(argv[++i])) << 20);
+        } else if (std::strcmp(argv[i], "--audible-bell") == 0) {
+            audible_bell = true;
+        } else if (std::strcmp(argv[i], "--trigger") == 0 && i + 1 < argc) {
+            triggers.push_back(argv[++i]);
+        } else if (std::strcmp(argv[i], "--local-echo") == 0 && i + 1 < argc) {
+            ++i;
+            if (std::strcmp(argv[i], "never") == 0) {
+                local_echo = LocalEcho::Mode::NEVER;
+            } else if (std::strcmp(argv[i], "adaptive") == 0) {
+                local_echo = LocalEcho::Mode::ADAPTIVE;
+            } else if (std::strcmp(argv[i], "always") == 0) {
+                local_echo = LocalEcho::Mode::ALWAYS;
+            } else {
+                usage();
+            }
+        } else if (std::strcmp(argv[i], "--delay-ms") == 0 && i + 1 < argc) {
+            output_delay = std::atoi(argv[++i]);
+        } else if (std::strcmp(argv[i], "--idle-test") == 0 && i + 1 < argc) {
+            idle_test_seconds = std::atoi(argv[++i]);
+        } else if (std::strcmp(argv[i], "--bench") == 0) {
+            bench = true;
+        } else if (std::strcmp(argv[i], "--perf") == 0) {
+            bench_perf = true;
+        } else if (std::strcmp(argv[i], "--screenshot") == 0 && i + 1 < argc) {
+            screenshot_mode        = true;
+            screenshots.output_dir = argv[++i];
+        } else if (std::strcmp(argv[i], "--geometry") == 0 && i + 1 < argc) {
+            if (std::sscanf(argv[++i], "%dx%d", &screenshots.cols, &screenshots.rows) != 2 ||
+                screenshots.cols < 1 || screenshots.rows < 1) {
+                usage();
+            }
+        } else if (std::strcmp(argv[i], "--at") == 0 && i + 1 < argc) {
+            screenshots.points.push_back(std::strtoul(argv[++i], nullptr, 0));
+        } else if (std::strcmp(argv[i], "--exec") == 0 && i + 1 < argc) {
+            screenshots.commands.push_back(argv[++i]);
+        } else if (screenshot_mode && argv[i][0] != '-') {
+            screenshots.files.push_back(argv[i]);
+        } else {
+            usage();
+        }
+    }
+
+    if (screenshot_mode) {
+        // No window: render into memory, many inputs in one run.
+        return run_screenshots(screenshots, SdlTerminal::default_font_path());
+    }
+
     SdlTerminal terminal(80, 24);
+    terminal.set_verbose(verbose);
+    terminal.set_audible_bell(audible_bell);
+    terminal.set_local_echo(local_echo);
+    terminal.set_output_delay(output_delay);
+    for (const auto &pattern : triggers) {
+        terminal.add_trigger(pattern);
+    }
+    if (bench) {
+        const size_t size = 8 << 20; // Per workload
+        terminal.set_bench({
+            { "ascii", gen_ascii(size) },
+            { "colors", gen_colors(size) },
+            { "redraw", gen_redraw(size) },
+        });
+        terminal.set_bench_perf(bench_perf);
+    }
     if (!terminal.initialize()) {
         return 1;
     }
+    if (idle_test_seconds > 0) {
+        return terminal.run_idle_test(idle_test_seconds) ? 0 : 1;
+    }
+    if (bench) {
+        return terminal.run_bench() ? 0 : 1;
+    }
     terminal.run();
     return 0;
 }
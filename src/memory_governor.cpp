@@ -0,0 +1,123 @@
+//
+// Process-wide memory budget for terminal sessions.
+//
+// Copyright (c) 2025 Serge Vakulenko
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include "memory_governor.h"
+
+#include <algorithm>
+
+MemoryGovernor &MemoryGovernor::instance()
+{
+    static MemoryGovernor governor;
+    return governor;
+}
+
+int MemoryGovernor::add_client(const std::string &name, Kind kind, UsageFunc usage,
+                               EvictFunc evict)
+{
+    int id = next_id++;
+    clients.push_back({ id, name, kind, std::move(usage), std::move(evict) });
+    clients.back().last_used = ++use_counter;
+    return id;
+}
+
+void MemoryGovernor::remove_client(int id)
+{
+    clients.erase(std::remove_if(clients.begin(), clients.end(),
+                                 [id](const Client &c) { return c.id == id; }),
+                  clients.end());
+}
+
+MemoryGovernor::Client *MemoryGovernor::find(int id)
+{
+    for (auto &c : clients) {
+        if (c.id == id)
+            return &c;
+    }
+    return nullptr;
+}
+
+void MemoryGovernor::set_focused(int id, bool focused)
+{
+    if (auto *c = find(id))
+        c->focused = focused;
+}
+
+void MemoryGovernor::touch(int id)
+{
+    if (auto *c = find(id))
+        c->last_used = ++use_counter;
+}
+
+size_t MemoryGovernor::total_usage() const
+{
+    size_t total = 0;
+    for (const auto &c : clients) {
+        total += c.usage();
+    }
+    return total;
+}
+
+bool MemoryGovernor::enforce()
+{
+    size_t usage = total_usage();
+    peak_usage   = std::max(peak_usage, usage);
+    if (usage <= budget)
+        return true;
+
+    // Coldest clients first.
+    std::vector<Client *> order;
+    for (auto &c : clients) {
+        order.push_back(&c);
+    }
+    std::sort(order.begin(), order.end(), [](const Client *a, const Client *b) {
+        if (a->focused != b->focused)
+            return !a->focused;
+        if (a->kind != b->kind)
+            return a->kind < b->kind;
+        return a->last_used < b->last_used;
+    });
+
+    for (auto *c : order) {
+        size_t released = c->evict(usage - budget);
+        if (released > 0) {
+            evictions++;
+            bytes_evicted += released;
+            usage -= std::min(released, usage);
+        }
+        if (usage <= budget)
+            return true;
+    }
+    return false;
+}
+
+MemoryGovernor::Stats MemoryGovernor::get_stats() const
+{
+    Stats stats;
+    stats.budget        = budget;
+    stats.usage         = total_usage();
+    stats.peak_usage    = std::max(peak_usage, stats.usage);
+    stats.evictions     = evictions;
+    stats.bytes_evicted = bytes_evicted;
+    stats.clients       = clients.size();
+    return stats;
+}
@@ -0,0 +1,106 @@
+//
+// Process-wide memory budget for terminal sessions.
+//
+// Copyright (c) 2025 Serge Vakulenko
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef MEMORY_GOVERNOR_H
+#define MEMORY_GOVERNOR_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+//
+// Every consumer of memory which can shrink on demand (scrollback history,
+// glyph and image caches) registers with the governor. When total usage
+// goes over the budget, the coldest data is evicted first:
+// background sessions before the focused one, history before caches,
+// least recently used before recently used.
+//
+class MemoryGovernor {
+public:
+    // Kind of data, in order of eviction.
+    enum class Kind { HISTORY, IMAGE_CACHE, GLYPH_CACHE };
+
+    // Get current usage in bytes.
+    using UsageFunc = std::function<size_t()>;
+
+    // Release at least given number of bytes, if possible.
+    // Return number of bytes actually released.
+    using EvictFunc = std::function<size_t(size_t bytes)>;
+
+    struct Stats {
+        size_t budget{};
+        size_t usage{};
+        size_t peak_usage{};
+        uint64_t evictions{};     // Number of evict calls which released memory
+        uint64_t bytes_evicted{}; // Total bytes released on demand
+        size_t clients{};
+    };
+
+    // Shared by all sessions of the process.
+    static MemoryGovernor &instance();
+
+    void set_budget(size_t bytes) { budget = bytes; }
+    size_t get_budget() const { return budget; }
+
+    // Register a client, return its id.
+    int add_client(const std::string &name, Kind kind, UsageFunc usage, EvictFunc evict);
+    void remove_client(int id);
+
+    // Focused clients are evicted last.
+    void set_focused(int id, bool focused);
+
+    // Mark client as recently used.
+    void touch(int id);
+
+    // Evict data when total usage is over the budget.
+    // Return true when usage fits the budget.
+    bool enforce();
+
+    Stats get_stats() const;
+
+private:
+    struct Client {
+        int id;
+        std::string name;
+        Kind kind;
+        UsageFunc usage;
+        EvictFunc evict;
+        bool focused{};
+        uint64_t last_used{};
+    };
+
+    size_t budget{ SIZE_MAX }; // Unlimited by default
+    std::vector<Client> clients;
+    int next_id{ 1 };
+    uint64_t use_counter{}; // Logical clock for least recently used order
+    size_t peak_usage{};
+    uint64_t evictions{};
+    uint64_t bytes_evicted{};
+
+    Client *find(int id);
+    size_t total_usage() const;
+};
+
+#endif // MEMORY_GOVERNOR_H
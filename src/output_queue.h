@@ -0,0 +1,60 @@
+//
+// Bounded queue of output waiting to be parsed.
+//
+// Copyright (c) 2025 Serge Vakulenko
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef OUTPUT_QUEUE_H
+#define OUTPUT_QUEUE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+
+//
+// Output of the child, read but not parsed yet, with time when it's due.
+// The queue doesn't refuse data: when it's full, the caller must stop
+// reading the PTY, so the kernel buffer fills up and the child blocks.
+//
+class OutputQueue {
+public:
+    explicit OutputQueue(size_t max_bytes) : limit(max_bytes) {}
+
+    bool empty() const { return chunks.empty(); }
+    bool is_full() const { return bytes >= limit; }
+    size_t get_bytes() const { return bytes; }
+
+    void push(const char *data, size_t length, uint64_t due);
+
+    // Take next chunk, when it's due by given time.
+    bool pop(uint64_t now, std::string &data);
+
+private:
+    struct Chunk {
+        uint64_t due;
+        std::string data;
+    };
+    std::deque<Chunk> chunks;
+    size_t bytes{};
+    size_t limit;
+};
+
+#endif // OUTPUT_QUEUE_H
@@ -0,0 +1,149 @@
+//
+// Hardware performance counters for benchmarks.
+//
+// Copyright (c) 2025 Serge Vakulenko
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include "perf_counters.h"
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cstring>
+#endif
+
+PerfCounters::~PerfCounters()
+{
+#ifdef __linux__
+    for (int fd : fds) {
+        if (fd != -1)
+            close(fd);
+    }
+#endif
+}
+
+const char *PerfCounters::name(Event event)
+{
+    switch (event) {
+    case INSTRUCTIONS:
+        return "instructions";
+    case CYCLES:
+        return "cycles";
+    case BRANCH_MISSES:
+        return "branch-misses";
+    case L1D_MISSES:
+        return "L1d-misses";
+    case LLC_MISSES:
+        return "LLC-misses";
+    default:
+        return "?";
+    }
+}
+
+bool PerfCounters::is_open() const
+{
+    for (int fd : fds) {
+        if (fd != -1)
+            return true;
+    }
+    return false;
+}
+
+#ifdef __linux__
+bool PerfCounters::open()
+{
+    static const struct {
+        uint32_t type;
+        uint64_t config;
+    } events[NUM_EVENTS] = {
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+        { PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                                  (PERF_COUNT_HW_CACHE_RESULT_MISS << 16) },
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+    };
+
+    for (int i = 0; i < NUM_EVENTS; ++i) {
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size           = sizeof(attr);
+        attr.type           = events[i].type;
+        attr.config         = events[i].config;
+        attr.disabled       = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv     = 1;
+        attr.read_format    = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+        // Unsupported events are silently skipped.
+        fds[i] = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+    }
+    return is_open();
+}
+
+void PerfCounters::start()
+{
+    for (int fd : fds) {
+        if (fd != -1) {
+            ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+            ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+}
+
+void PerfCounters::stop()
+{
+    for (int fd : fds) {
+        if (fd != -1)
+            ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+    }
+}
+
+bool PerfCounters::get(Event event, uint64_t &value) const
+{
+    uint64_t data[3]; // value, time enabled, time running
+    if (fds[event] == -1 || read(fds[event], data, sizeof(data)) != sizeof(data)) {
+        return false;
+    }
+    if (data[2] == 0) {
+        // Never scheduled on the PMU.
+        return false;
+    }
+    value = data[2] < data[1] ? data[0] * (double(data[1]) / data[2]) : data[0];
+    return true;
+}
+#else
+bool PerfCounters::open()
+{
+    return false;
+}
+
+void PerfCounters::start() {}
+
+void PerfCounters::stop() {}
+
+bool PerfCounters::get(Event, uint64_t &) const
+{
+    return false;
+}
+#endif
@@ -0,0 +1,69 @@
+//
+// Hardware performance counters for benchmarks.
+//
+// Copyright (c) 2025 Serge Vakulenko
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+#include <cstdint>
+
+//
+// Set of hardware counters, measured around a workload.
+// On Linux they are read via perf_event_open(2); elsewhere,
+// or when the kernel denies access, open() returns false
+// and the benchmarks report wall-clock time only.
+//
+class PerfCounters {
+public:
+    enum Event {
+        INSTRUCTIONS,
+        CYCLES,
+        BRANCH_MISSES,
+        L1D_MISSES,
+        LLC_MISSES,
+        NUM_EVENTS,
+    };
+
+    PerfCounters() = default;
+    ~PerfCounters();
+    PerfCounters(const PerfCounters &) = delete;
+    PerfCounters &operator=(const PerfCounters &) = delete;
+
+    // Open counters for this process. Return false when none is available.
+    bool open();
+    bool is_open() const;
+
+    // Reset and enable all counters, then freeze them.
+    void start();
+    void stop();
+
+    // Value accumulated between start() and stop(), scaled for multiplexing.
+    // Return false when this event is not supported.
+    bool get(Event event, uint64_t &value) const;
+
+    static const char *name(Event event);
+
+private:
+    int fds[NUM_EVENTS]{ -1, -1, -1, -1, -1 };
+};
+
+#endif // PERF_COUNTERS_H
@@ -0,0 +1,476 @@
+//
+// Minimal PNG decoder, without external libraries.
+//
+// Copyright (c) 2025 Serge Vakulenko
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include "png_reader.h"
+
+#include "png_writer.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+
+//
+// Deflate bit stream: data bits go least significant first,
+// Huffman codes go most significant first.
+//
+class BitReader {
+public:
+    BitReader(const uint8_t *data, size_t length) : in(data), size(length) {}
+
+    // Past the end of data, zero bits are returned and the error is set.
+    uint32_t get_bits(int count)
+    {
+        while (nbits < count) {
+            if (pos == size) {
+                error = true;
+                return 0;
+            }
+            acc |= uint32_t(in[pos++]) << nbits;
+            nbits += 8;
+        }
+        uint32_t bits = acc & ((1u << count) - 1);
+        acc >>= count;
+        nbits -= count;
+        return bits;
+    }
+
+    // Skip to the byte boundary, and take bytes as they are.
+    bool get_bytes(size_t count, std::vector<uint8_t> &out)
+    {
+        acc   = 0;
+        nbits = 0;
+        if (count > size - pos) {
+            error = true;
+            return false;
+        }
+        out.insert(out.end(), in + pos, in + pos + count);
+        pos += count;
+        return true;
+    }
+
+    size_t get_pos() const { return pos; }
+    bool failed() const { return error; }
+
+private:
+    const uint8_t *in;
+    size_t size;
+    size_t pos{};
+    uint32_t acc{};
+    int nbits{};
+    bool error{};
+};
+
+//
+// Canonical Huffman code, given by lengths of codes of all symbols.
+// Symbols are decoded bit by bit: codes of the same length are consecutive.
+//
+class Huffman {
+public:
+    // Return false when the lengths are over-subscribed.
+    bool build(const uint8_t *lengths, int n)
+    {
+        std::fill(std::begin(count), std::end(count), 0);
+        for (int s = 0; s < n; ++s) {
+            count[lengths[s]]++;
+        }
+        int left = 1;
+        for (int len = 1; len <= max_bits; ++len) {
+            left = (left << 1) - count[len];
+            if (left < 0)
+                return false;
+        }
+        uint16_t offset[max_bits + 1];
+        offset[1] = 0;
+        for (int len = 1; len < max_bits; ++len) {
+            offset[len + 1] = offset[len] + count[len];
+        }
+        for (int s = 0; s < n; ++s) {
+            if (lengths[s] != 0) {
+                symbol[offset[lengths[s]]++] = s;
+            }
+        }
+        return true;
+    }
+
+    // Return -1 on invalid code.
+    int decode(BitReader &in) const
+    {
+        int code  = 0; // Bits read so far
+        int first = 0; // First code of this length
+        int index = 0; // Symbols of shorter codes
+        for (int len = 1; len <= max_bits; ++len) {
+            code |= in.get_bits(1);
+            if (code - first < count[len])
+                return symbol[index + code - first];
+            index += count[len];
+            first = (first + count[len]) << 1;
+            code <<= 1;
+        }
+        return -1;
+    }
+
+private:
+    static const int max_bits = 15;
+    uint16_t count[max_bits + 1];
+    uint16_t symbol[288];
+};
+
+const int length_base[29]  = { 3,  4,  5,  6,  7,  8,  9,  10,  11,  13,  15,  17,  19,  23, 27,
+                               31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+const int length_extra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2,
+                               2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+const int dist_base[30]    = { 1,    2,    3,    4,    5,    7,     9,     13,    17,  25,
+                               33,   49,   65,   97,   129,  193,   257,   385,   513, 769,
+                               1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+const int dist_extra[30]   = { 0, 0, 0, 0, 1, 1, 2, 2,  3,  3,  4,  4,  5,  5,  6,
+                               6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+//
+// Decode symbols of a compressed block, up to the end of block.
+//
+bool inflate_block(BitReader &in, const Huffman &lit, const Huffman &dist, size_t max_length,
+                   std::vector<uint8_t> &out)
+{
+    for (;;) {
+        int sym = lit.decode(in);
+        if (sym < 0 || in.failed())
+            return false;
+        if (sym < 256) {
+            if (out.size() == max_length)
+                return false;
+            out.push_back(sym);
+            continue;
+        }
+        if (sym == 256)
+            return true;
+
+        sym -= 257;
+        if (sym >= 29)
+            return false;
+        size_t length = length_base[sym] + in.get_bits(length_extra[sym]);
+        int d         = dist.decode(in);
+        if (d < 0 || d >= 30)
+            return false;
+        size_t distance = dist_base[d] + in.get_bits(dist_extra[d]);
+        if (in.failed() || distance > out.size() || length > max_length - out.size())
+            return false;
+
+        // Source may overlap the bytes being written.
+        size_t from = out.size() - distance;
+        for (size_t i = 0; i < length; ++i) {
+            out.push_back(out[from + i]);
+        }
+    }
+}
+
+//
+// Read code lengths of a block with dynamic Huffman codes.
+//
+bool read_dynamic_codes(BitReader &in, Huffman &lit, Huffman &dist)
+{
+    static const uint8_t order[19] = { 16, 17, 18, 0, 8,  7, 9,  6, 10, 5,
+                                       11, 4,  12, 3, 13, 2, 14, 1, 15 };
+    int nlit  = in.get_bits(5) + 257;
+    int ndist = in.get_bits(5) + 1;
+    int ncode = in.get_bits(4) + 4;
+    if (nlit > 286 || ndist > 30)
+        return false;
+
+    uint8_t lengths[286 + 30]{};
+    for (int i = 0; i < ncode; ++i) {
+        lengths[order[i]] = in.get_bits(3);
+    }
+    Huffman codes;
+    if (!codes.build(lengths, 19))
+        return false;
+
+    std::fill(std::begin(lengths), std::end(lengths), 0);
+    for (int n = 0; n < nlit + ndist;) {
+        int sym = codes.decode(in);
+        if (sym < 0 || in.failed())
+            return false;
+        if (sym < 16) {
+            lengths[n++] = sym;
+            continue;
+        }
+        int value = 0;
+        int repeat;
+        if (sym == 16) {
+            if (n == 0)
+                return false;
+            value  = lengths[n - 1];
+            repeat = 3 + in.get_bits(2);
+        } else if (sym == 17) {
+            repeat = 3 + in.get_bits(3);
+        } else {
+            repeat = 11 + in.get_bits(7);
+        }
+        if (n + repeat > nlit + ndist)
+            return false;
+        std::fill(lengths + n, lengths + n + repeat, value);
+        n += repeat;
+    }
+    if (lengths[256] == 0)
+        return false;
+    return lit.build(lengths, nlit) && dist.build(lengths + nlit, ndist);
+}
+
+//
+// Sample of a row, at its own depth.
+//
+int get_sample(const uint8_t *row, size_t index, int depth)
+{
+    switch (depth) {
+    case 16:
+        return (row[index * 2] << 8) | row[index * 2 + 1];
+    case 8:
+        return row[index];
+    default:
+        int shift = 8 - depth - (index * depth) % 8;
+        return (row[index * depth / 8] >> shift) & ((1 << depth) - 1);
+    }
+}
+
+//
+// Sample scaled to 8 bits: lower depths are scaled up,
+// 16-bit samples are cut to their high byte.
+//
+uint8_t to_byte(int sample, int depth)
+{
+    if (depth == 16)
+        return sample >> 8;
+    return (depth < 8) ? sample * (255 / ((1 << depth) - 1)) : sample;
+}
+
+int paeth(int a, int b, int c)
+{
+    int p  = a + b - c;
+    int pa = std::abs(p - a);
+    int pb = std::abs(p - b);
+    int pc = std::abs(p - c);
+    if (pa <= pb && pa <= pc)
+        return a;
+    return (pb <= pc) ? b : c;
+}
+
+uint32_t get32(const uint8_t *p)
+{
+    return (uint32_t(p[0]) << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+} // namespace
+
+bool zlib_decompress(const uint8_t *data, size_t length, size_t max_length,
+                     std::vector<uint8_t> &out)
+{
+    // Method deflate, no preset dictionary.
+    if (length < 6 || (data[0] & 0x0f) != 8 || ((data[0] << 8) | data[1]) % 31 != 0 ||
+        (data[1] & 0x20))
+        return false;
+
+    BitReader in(data + 2, length - 2);
+    static Huffman fixed_lit, fixed_dist;
+    static bool fixed_ready = [] {
+        uint8_t lengths[288];
+        std::fill(lengths, lengths + 144, 8);
+        std::fill(lengths + 144, lengths + 256, 9);
+        std::fill(lengths + 256, lengths + 280, 7);
+        std::fill(lengths + 280, lengths + 288, 8);
+        fixed_lit.build(lengths, 288);
+        std::fill(lengths, lengths + 30, 5);
+        fixed_dist.build(lengths, 30);
+        return true;
+    }();
+    (void)fixed_ready;
+
+    bool last;
+    do {
+        last     = in.get_bits(1);
+        int type = in.get_bits(2);
+        if (type == 0) {
+            // Stored block: length, and its complement.
+            std::vector<uint8_t> header;
+            if (!in.get_bytes(4, header) || (header[0] ^ header[2]) != 0xff ||
+                (header[1] ^ header[3]) != 0xff)
+                return false;
+            size_t count = header[0] | (header[1] << 8);
+            if (count > max_length - out.size() || !in.get_bytes(count, out))
+                return false;
+        } else if (type == 1) {
+            if (!inflate_block(in, fixed_lit, fixed_dist, max_length, out))
+                return false;
+        } else if (type == 2) {
+            Huffman lit, dist;
+            if (!read_dynamic_codes(in, lit, dist) ||
+                !inflate_block(in, lit, dist, max_length, out))
+                return false;
+        } else {
+            return false;
+        }
+        if (in.failed())
+            return false;
+    } while (!last);
+
+    // Checksum follows at the byte boundary.
+    std::vector<uint8_t> adler;
+    return in.get_bytes(4, adler) && get32(adler.data()) == png_adler32(out.data(), out.size());
+}
+
+bool decode_png(const uint8_t *data, size_t length, size_t max_bytes, int &width, int &height,
+                std::vector<uint8_t> &pixels)
+{
+    static const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+    if (length < 8 || std::memcmp(data, signature, 8) != 0)
+        return false;
+
+    // Chunks: length, type, data, checksum of type and data.
+    int depth = 0, color = -1;
+    std::vector<uint8_t> palette; // RGBA
+    int key[3] = { -1, -1, -1 }; // Transparent gray or RGB
+    std::vector<uint8_t> compressed;
+    bool ended = false;
+    for (size_t pos = 8; !ended;) {
+        if (length - pos < 12)
+            return false;
+        uint32_t size = get32(data + pos);
+        if (size > length - pos - 12)
+            return false;
+        const uint8_t *type  = data + pos + 4;
+        const uint8_t *chunk = data + pos + 8;
+        if (png_crc32(type, size + 4) != get32(chunk + size))
+            return false;
+        pos += size + 12;
+
+        if (std::memcmp(type, "IHDR", 4) == 0 && size == 13) {
+            width  = get32(chunk);
+            height = get32(chunk + 4);
+            depth  = chunk[8];
+            color  = chunk[9];
+            if (chunk[10] != 0 || chunk[11] != 0 || chunk[12] != 0)
+                return false; // Unknown method, or interlace
+        } else if (std::memcmp(type, "PLTE", 4) == 0 && size % 3 == 0 && size <= 3 * 256) {
+            palette.clear();
+            for (uint32_t i = 0; i < size; i += 3) {
+                palette.insert(palette.end(), { chunk[i], chunk[i + 1], chunk[i + 2], 255 });
+            }
+        } else if (std::memcmp(type, "tRNS", 4) == 0 && color == 3) {
+            for (uint32_t i = 0; i < size && 4 * i + 3 < palette.size(); ++i) {
+                palette[4 * i + 3] = chunk[i];
+            }
+        } else if (std::memcmp(type, "tRNS", 4) == 0 && (color == 0 || color == 2) &&
+                   size == (color == 0 ? 2u : 6u)) {
+            for (uint32_t i = 0; i < size / 2; ++i) {
+                key[i] = (chunk[2 * i] << 8) | chunk[2 * i + 1];
+            }
+        } else if (std::memcmp(type, "IDAT", 4) == 0) {
+            compressed.insert(compressed.end(), chunk, chunk + size);
+        } else if (std::memcmp(type, "IEND", 4) == 0) {
+            ended = true;
+        }
+    }
+
+    // Samples per pixel, for every color type: gray, -, RGB, palette, gray+alpha, -, RGBA.
+    static const int channels_of[7] = { 1, 0, 3, 1, 2, 0, 4 };
+    int channels    = (color >= 0 && color < 7) ? channels_of[color] : 0;
+    bool good_depth = (depth == 1 || depth == 2 || depth == 4 || depth == 8 || depth == 16);
+    if (channels == 0 || !good_depth || (depth < 8 && channels > 1) ||
+        (depth == 16 && color == 3) || (color == 3 && palette.empty()) || width <= 0 ||
+        height <= 0 || size_t(width) * height > max_bytes / 4)
+        return false;
+
+    // Every row starts with the type of its filter.
+    size_t pixel_bits = size_t(channels) * depth;
+    size_t row_bytes  = (width * pixel_bits + 7) / 8;
+    size_t bpp        = std::max<size_t>(1, pixel_bits / 8);
+    std::vector<uint8_t> raw;
+    raw.reserve((row_bytes + 1) * height);
+    if (!zlib_decompress(compressed.data(), compressed.size(), (row_bytes + 1) * height, raw) ||
+        raw.size() != (row_bytes + 1) * height)
+        return false;
+
+    pixels.resize(size_t(width) * height * 4);
+    uint8_t *out = pixels.data();
+    for (int y = 0; y < height; ++y) {
+        uint8_t *row      = &raw[y * (row_bytes + 1) + 1];
+        const uint8_t *up = (y > 0) ? row - (row_bytes + 1) : nullptr;
+        int filter        = row[-1];
+        for (size_t i = 0; i < row_bytes; ++i) {
+            int a = (i >= bpp) ? row[i - bpp] : 0;
+            int b = up ? up[i] : 0;
+            int c = (up && i >= bpp) ? up[i - bpp] : 0;
+            switch (filter) {
+            case 0:
+                break;
+            case 1:
+                row[i] += a;
+                break;
+            case 2:
+                row[i] += b;
+                break;
+            case 3:
+                row[i] += (a + b) / 2;
+                break;
+            case 4:
+                row[i] += paeth(a, b, c);
+                break;
+            default:
+                return false;
+            }
+        }
+
+        for (int x = 0; x < width; ++x) {
+            size_t index = size_t(x) * channels;
+            if (color == 3) {
+                size_t entry = get_sample(row, index, depth);
+                if (4 * entry >= palette.size())
+                    return false;
+                std::copy_n(&palette[4 * entry], 4, out);
+            } else {
+                // Color and alpha follow gray or RGB; without alpha, tRNS may mark
+                // one color as transparent.
+                int sample[4];
+                for (int i = 0; i < channels; ++i) {
+                    sample[i] = get_sample(row, index + i, depth);
+                }
+                bool keyed = (channels == 1 && sample[0] == key[0]) ||
+                             (channels == 3 && sample[0] == key[0] && sample[1] == key[1] &&
+                              sample[2] == key[2]);
+                if (channels >= 3) {
+                    out[0] = to_byte(sample[0], depth);
+                    out[1] = to_byte(sample[1], depth);
+                    out[2] = to_byte(sample[2], depth);
+                } else {
+                    out[0] = out[1] = out[2] = to_byte(sample[0], depth);
+                }
+                if (channels % 2 == 0)
+                    out[3] = to_byte(sample[channels - 1], depth);
+                else
+                    out[3] = keyed ? 0 : 255;
+            }
+            out += 4;
+        }
+    }
+    return true;
+}
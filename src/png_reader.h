@@ -0,0 +1,44 @@
+//
+// Minimal PNG decoder, without external libraries.
+//
+// Copyright (c) 2025 Serge Vakulenko
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef PNG_READER_H
+#define PNG_READER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+//
+// Decode PNG file into RGBA pixels (4 bytes per pixel), top row first.
+// All color types and bit depths are supported, without interlace.
+// Images with more than max_bytes of pixels are rejected before inflating.
+// Return false on error.
+//
+bool decode_png(const uint8_t *data, size_t length, size_t max_bytes, int &width, int &height,
+                std::vector<uint8_t> &pixels);
+
+// Decompress zlib stream; output larger than max_length is an error.
+bool zlib_decompress(const uint8_t *data, size_t length, size_t max_length,
+                     std::vector<uint8_t> &out);
+
+#endif // PNG_READER_H
@@ -0,0 +1,233 @@
+//
+// Minimal PNG encoder, without external libraries.
+//
+// Copyright (c) 2025 Serge Vakulenko
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include "png_writer.h"
+
+#include <algorithm>
+#include <fstream>
+#include <vector>
+
+uint32_t png_crc32(const uint8_t *data, size_t length, uint32_t crc)
+{
+    static uint32_t table[256];
+    if (table[1] == 0) {
+        for (uint32_t n = 0; n < 256; ++n) {
+            uint32_t c = n;
+            for (int k = 0; k < 8; ++k) {
+                c = (c & 1) ? 0xedb88320 ^ (c >> 1) : c >> 1;
+            }
+            table[n] = c;
+        }
+    }
+    crc = ~crc;
+    for (size_t i = 0; i < length; ++i) {
+        crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+uint32_t png_adler32(const uint8_t *data, size_t length)
+{
+    uint32_t a = 1, b = 0;
+    while (length > 0) {
+        // Sums don't overflow in 5552 steps.
+        size_t n = std::min<size_t>(length, 5552);
+        length -= n;
+        while (n-- > 0) {
+            a += *data++;
+            b += a;
+        }
+        a %= 65521;
+        b %= 65521;
+    }
+    return (b << 16) | a;
+}
+
+namespace {
+
+//
+// Deflate bit stream: data bits go least significant first,
+// Huffman codes go most significant first.
+//
+class BitWriter {
+public:
+    explicit BitWriter(std::string &output) : out(output) {}
+
+    void put_bits(uint32_t bits, int count)
+    {
+        acc |= bits << nbits;
+        nbits += count;
+        while (nbits >= 8) {
+            out += static_cast<char>(acc & 0xff);
+            acc >>= 8;
+            nbits -= 8;
+        }
+    }
+
+    void put_code(uint32_t code, int count)
+    {
+        uint32_t reversed = 0;
+        for (int i = 0; i < count; ++i) {
+            reversed = (reversed << 1) | ((code >> i) & 1);
+        }
+        put_bits(reversed, count);
+    }
+
+    // Literal/length symbol with fixed Huffman code.
+    void put_symbol(int value)
+    {
+        if (value < 144) {
+            put_code(0x30 + value, 8);
+        } else if (value < 256) {
+            put_code(0x190 + value - 144, 9);
+        } else if (value < 280) {
+            put_code(value - 256, 7);
+        } else {
+            put_code(0xc0 + value - 280, 8);
+        }
+    }
+
+    // Repeat previous byte: length 3...258, distance 1.
+    void put_run(int length)
+    {
+        static const int base[29]  = { 3,  4,  5,  6,  7,  8,  9,  10,  11,  13,
+                                       15, 17, 19, 23, 27, 31, 35, 43,  51,  59,
+                                       67, 83, 99, 115, 131, 163, 195, 227, 258 };
+        static const int extra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2,
+                                       2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+        int i = 28;
+        while (base[i] > length) {
+            --i;
+        }
+        put_symbol(257 + i);
+        put_bits(length - base[i], extra[i]);
+        put_code(0, 5); // Distance code 0: distance 1
+    }
+
+    void flush()
+    {
+        if (nbits > 0) {
+            out += static_cast<char>(acc & 0xff);
+        }
+        acc   = 0;
+        nbits = 0;
+    }
+
+private:
+    std::string &out;
+    uint32_t acc{};
+    int nbits{};
+};
+
+//
+// Compress data into zlib stream: one final deflate block with fixed codes.
+//
+std::string zlib_compress(const std::vector<uint8_t> &data)
+{
+    std::string out = "\x78\x01";
+    BitWriter bits(out);
+    bits.put_bits(1, 1); // Final block
+    bits.put_bits(1, 2); // Fixed Huffman codes
+
+    const size_t n = data.size();
+    for (size_t i = 0; i < n;) {
+        size_t run = 0;
+        if (i > 0) {
+            while (i + run < n && run < 258 && data[i + run] == data[i - 1]) {
+                ++run;
+            }
+        }
+        if (run >= 3) {
+            bits.put_run(run);
+            i += run;
+        } else {
+            bits.put_symbol(data[i]);
+            ++i;
+        }
+    }
+    bits.put_symbol(256); // End of block
+    bits.flush();
+
+    uint32_t adler = png_adler32(data.data(), data.size());
+    for (int shift = 24; shift >= 0; shift -= 8) {
+        out += static_cast<char>(adler >> shift);
+    }
+    return out;
+}
+
+void put_uint32(std::string &out, uint32_t value)
+{
+    for (int shift = 24; shift >= 0; shift -= 8) {
+        out += static_cast<char>(value >> shift);
+    }
+}
+
+void put_chunk(std::string &out, const char *type, const std::string &data)
+{
+    put_uint32(out, data.size());
+    std::string body = type + data;
+    out += body;
+    put_uint32(out, png_crc32(reinterpret_cast<const uint8_t *>(body.data()), body.size()));
+}
+
+} // namespace
+
+std::string encode_png(const uint8_t *pixels, int width, int height, int pitch)
+{
+    // Filter type 2 (Up): every byte minus the byte above it.
+    const size_t row_bytes = 3 * width;
+    std::vector<uint8_t> raw;
+    raw.reserve((row_bytes + 1) * height);
+    for (int y = 0; y < height; ++y) {
+        const uint8_t *row = pixels + y * pitch;
+        raw.push_back(y == 0 ? 0 : 2);
+        for (size_t x = 0; x < row_bytes; ++x) {
+            raw.push_back(y == 0 ? row[x] : row[x] - row[x - pitch]);
+        }
+    }
+
+    std::string header;
+    put_uint32(header, width);
+    put_uint32(header, height);
+    header += '\x08'; // Bit depth
+    header += '\x02'; // Color type: RGB
+    header += std::string(3, '\0');
+
+    std::string png = "\x89PNG\r\n\x1a\n";
+    put_chunk(png, "IHDR", header);
+    put_chunk(png, "IDAT", zlib_compress(raw));
+    put_chunk(png, "IEND", "");
+    return png;
+}
+
+bool write_png(const std::string &filename, const uint8_t *pixels, int width, int height,
+               int pitch)
+{
+    std::ofstream file(filename, std::ios::binary);
+    if (!file) {
+        return false;
+    }
+    std::string png = encode_png(pixels, width, height, pitch);
+    file.write(png.data(), png.size());
+    return file.good();
+}
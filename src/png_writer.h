@@ -0,0 +1,46 @@
+//
+// Minimal PNG encoder, without external libraries.
+//
+// Copyright (c) 2025 Serge Vakulenko
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef PNG_WRITER_H
+#define PNG_WRITER_H
+
+#include <cstdint>
+#include <string>
+
+//
+// Encode RGB image (3 bytes per pixel) as PNG.
+// Compression is deflate with fixed Huffman codes and run-length matches:
+// rows are filtered against the previous row, so flat areas of terminal
+// screenshots become long runs of zeros.
+//
+std::string encode_png(const uint8_t *pixels, int width, int height, int pitch);
+
+// Write PNG file; return false on error.
+bool write_png(const std::string &filename, const uint8_t *pixels, int width, int height,
+               int pitch);
+
+// Checksums used by PNG format, exposed for tests.
+uint32_t png_crc32(const uint8_t *data, size_t length, uint32_t crc = 0);
+uint32_t png_adler32(const uint8_t *data, size_t length);
+
+#endif // PNG_WRITER_H
@@ -0,0 +1,451 @@
+//
+// Reference model of the ANSI logic, for differential tests.
+//
+// Copyright (c) 2025 Serge Vakulenko
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include "reference_logic.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+
+static const RgbColor normal_colors[8] = {
+    { 0, 0, 0 },       // Black
+    { 192, 0, 0 },     // Red
+    { 0, 192, 0 },     // Green
+    { 192, 85, 0 },    // Yellow (Brown)
+    { 0, 0, 192 },     // Blue
+    { 192, 0, 192 },   // Magenta
+    { 0, 192, 192 },   // Cyan
+    { 192, 192, 192 }, // White (Light Gray)
+};
+
+static const RgbColor bright_colors[8] = {
+    { 85, 85, 85 },    // Bright Black (Gray)
+    { 255, 0, 0 },     // Bright Red
+    { 0, 255, 0 },     // Bright Green
+    { 255, 255, 0 },   // Bright Yellow
+    { 0, 0, 255 },     // Bright Blue
+    { 255, 0, 255 },   // Bright Magenta
+    { 0, 255, 255 },   // Bright Cyan
+    { 255, 255, 255 }, // Bright White
+};
+
+ReferenceLogic::ReferenceLogic(int cols, int rows) : term_cols(cols), term_rows(rows)
+{
+    text_buffer.resize(term_rows, std::vector<Char>(term_cols, { L' ', current_attr }));
+    reset_margins();
+}
+
+void ReferenceLogic::process_input(const char *buffer, size_t length)
+{
+    for (size_t i = 0; i < length; ++i) {
+        char c = buffer[i];
+        switch (state) {
+        case AnsiState::NORMAL:
+            switch (c) {
+            case '\033':
+                state = AnsiState::ESCAPE;
+                ansi_seq.clear();
+                break;
+            case '\n':
+                line_feed();
+                carriage_return();
+                break;
+            case '\r':
+                carriage_return();
+                break;
+            case '\b':
+                if (cursor.col > 0) {
+                    cursor.col--;
+                    text_buffer[cursor.row][cursor.col] = { L' ', current_attr };
+                }
+                break;
+            case '\t':
+                cursor.col = std::min((cursor.col + 8) / 8 * 8, term_cols - 1);
+                break;
+            case '\7':
+                break;
+            default:
+                // Decode UTF-8 sequence, only when it's complete in this buffer
+                if ((c & 0x80) == 0) {
+                    put_char(c);
+                } else if ((c & 0xE0) == 0xC0 && i + 1 < length) {
+                    put_char(((c & 0x1F) << 6) | (buffer[i + 1] & 0x3F));
+                    i += 1;
+                } else if ((c & 0xF0) == 0xE0 && i + 2 < length) {
+                    put_char(((c & 0x0F) << 12) | ((buffer[i + 1] & 0x3F) << 6) |
+                             (buffer[i + 2] & 0x3F));
+                    i += 2;
+                } else if ((c & 0xF8) == 0xF0 && i + 3 < length) {
+                    put_char(((c & 0x07) << 18) | ((buffer[i + 1] & 0x3F) << 12) |
+                             ((buffer[i + 2] & 0x3F) << 6) | (buffer[i + 3] & 0x3F));
+                    i += 3;
+                }
+                break;
+            }
+            break;
+
+        case AnsiState::ESCAPE:
+            if (c == '[') {
+                state    = AnsiState::CSI;
+                ansi_seq = c;
+            } else if (c == ']') {
+                state = AnsiState::OSC;
+            } else {
+                if (c == 'c') {
+                    current_attr = CharAttr();
+                    saved_cursor = Cursor();
+                    saved_attr   = CharAttr();
+                    reset_margins();
+                    clear_screen();
+                } else if (c == 'D') {
+                    line_feed();
+                } else if (c == 'E') {
+                    line_feed();
+                    carriage_return();
+                } else if (c == 'M') {
+                    reverse_index();
+                } else if (c == '7') {
+                    saved_cursor = cursor;
+                    saved_attr   = current_attr;
+                } else if (c == '8') {
+                    cursor       = saved_cursor;
+                    current_attr = saved_attr;
+                }
+                state = AnsiState::NORMAL;
+                ansi_seq.clear();
+            }
+            break;
+
+        case AnsiState::CSI:
+            ansi_seq += c;
+            if (c >= 0x40 && c <= 0x7e) {
+                parse_ansi_sequence(ansi_seq);
+                state = AnsiState::NORMAL;
+                ansi_seq.clear();
+            }
+            break;
+
+        case AnsiState::OSC:
+            // Operating system commands don't change the screen
+            if (c == '\7') {
+                state = AnsiState::NORMAL;
+            } else if (c == '\033') {
+                state = AnsiState::ESCAPE;
+            }
+            break;
+        }
+    }
+}
+
+//
+// Between left and right margins, text wraps at the right margin to the left one.
+//
+void ReferenceLogic::put_char(wchar_t ch)
+{
+    bool inside = in_column_margins();
+    text_buffer[cursor.row][cursor.col] = { ch, current_attr };
+    cursor.col++;
+    last_char = ch;
+    if (cursor.col > (inside ? margin_right : term_cols - 1)) {
+        cursor.col = inside ? margin_left : 0;
+        line_feed();
+    }
+}
+
+void ReferenceLogic::line_feed()
+{
+    if (cursor.row == margin_bottom && in_column_margins()) {
+        scroll(margin_top, margin_left, margin_bottom, margin_right, 1);
+    } else if (cursor.row < term_rows - 1) {
+        cursor.row++;
+    }
+}
+
+void ReferenceLogic::reverse_index()
+{
+    if (cursor.row == margin_top && in_column_margins()) {
+        scroll(margin_top, margin_left, margin_bottom, margin_right, -1);
+    } else if (cursor.row > 0) {
+        cursor.row--;
+    }
+}
+
+void ReferenceLogic::carriage_return()
+{
+    cursor.col = (cursor.col >= margin_left) ? margin_left : 0;
+}
+
+bool ReferenceLogic::in_column_margins() const
+{
+    return cursor.col >= margin_left && cursor.col <= margin_right;
+}
+
+//
+// Column past the last one that editing at the cursor may touch.
+//
+int ReferenceLogic::row_end() const
+{
+    return in_column_margins() ? margin_right + 1 : term_cols;
+}
+
+void ReferenceLogic::parse_ansi_sequence(const std::string &seq)
+{
+    // Parameters are separated by ';', empty or malformed ones are 0
+    // Private marker like '?' comes first; sequences with intermediates are not modelled.
+    std::vector<int> params;
+    std::string param_str;
+    char marker = (seq.size() > 2 && seq[1] >= 0x3c && seq[1] <= 0x3f) ? seq[1] : 0;
+    for (size_t i = 1; i < seq.size(); ++i) {
+        char c     = seq[i];
+        bool final = (i == seq.size() - 1);
+        if (std::isdigit(c)) {
+            param_str += c;
+        } else if (c >= 0x20 && c <= 0x2f && !final) {
+            return;
+        } else if (c == ';' || final) {
+            try {
+                params.push_back(param_str.empty() ? 0 : std::stoi(param_str));
+            } catch (const std::exception &) {
+                params.push_back(0);
+            }
+            param_str.clear();
+        }
+    }
+
+    // Parameter with given default, which is also the minimum
+    auto param = [&params](size_t index, int default_value) {
+        return (index < params.size() && params[index] > default_value) ? params[index]
+                                                                        : default_value;
+    };
+    auto clear = [this](int row, int from, int to) {
+        for (int c = from; c < to; ++c) {
+            text_buffer[row][c] = { L' ', current_attr };
+        }
+    };
+    std::vector<Char> &line = text_buffer[cursor.row];
+
+    switch (seq.back()) {
+    case 'm': {
+        const RgbColor *colors = normal_colors;
+        for (int p : params) {
+            if (p == 0) {
+                bool protect         = current_attr.protect;
+                colors               = normal_colors;
+                current_attr         = CharAttr();
+                current_attr.protect = protect;
+            } else if (p == 1) {
+                colors          = bright_colors;
+                current_attr.fg = bright_colors[7];
+            } else if (p >= 30 && p <= 37) {
+                current_attr.fg = colors[p - 30];
+            } else if (p >= 40 && p <= 47) {
+                current_attr.bg = colors[p - 40];
+            } else if (p == 39) {
+                current_attr.fg = CharAttr().fg;
+            } else if (p == 49) {
+                current_attr.bg = CharAttr().bg;
+            } else if (p >= 90 && p <= 97) {
+                current_attr.fg = bright_colors[p - 90];
+            } else if (p >= 100 && p <= 107) {
+                current_attr.bg = bright_colors[p - 100];
+            }
+        }
+        break;
+    }
+    case 'H':
+    case 'f':
+        cursor.row = std::min(param(0, 1) - 1, term_rows - 1);
+        cursor.col = std::min(param(1, 1) - 1, term_cols - 1);
+        break;
+    case 'G':
+    case '`':
+        cursor.col = std::min(param(0, 1) - 1, term_cols - 1);
+        break;
+    case 'd':
+        cursor.row = std::min(param(0, 1) - 1, term_rows - 1);
+        break;
+    case 'b':
+        if (last_char) {
+            for (int n = std::min(param(0, 1), term_cols * term_rows); n > 0; --n) {
+                put_char(last_char);
+            }
+        }
+        break;
+    case 'X':
+        clear(cursor.row, cursor.col, std::min(cursor.col + param(0, 1), row_end()));
+        break;
+    case '@':
+        // Shift right cell by cell, from the end of the row or the right margin
+        for (int n = std::min(param(0, 1), row_end() - cursor.col); n > 0; --n) {
+            for (int c = row_end() - 1; c > cursor.col; --c) {
+                line[c] = line[c - 1];
+            }
+            line[cursor.col] = { L' ', current_attr };
+        }
+        break;
+    case 'P':
+        for (int n = std::min(param(0, 1), row_end() - cursor.col); n > 0; --n) {
+            for (int c = cursor.col; c < row_end() - 1; ++c) {
+                line[c] = line[c + 1];
+            }
+            line[row_end() - 1] = { L' ', current_attr };
+        }
+        break;
+    case 'r':
+        if (!marker) {
+            int bottom = std::min(params.size() > 1 && params[1] > 0 ? params[1] : term_rows,
+                                  term_rows);
+            if (param(0, 1) < bottom) {
+                margin_top    = param(0, 1) - 1;
+                margin_bottom = bottom - 1;
+                cursor        = {};
+            }
+        }
+        break;
+    case 's':
+        if (!marker && lr_margin_mode) {
+            int right = std::min(params.size() > 1 && params[1] > 0 ? params[1] : term_cols,
+                                 term_cols);
+            if (param(0, 1) < right) {
+                margin_left  = param(0, 1) - 1;
+                margin_right = right - 1;
+                cursor       = {};
+            }
+        } else if (!marker) {
+            saved_cursor = cursor;
+            saved_attr   = current_attr;
+        }
+        break;
+    case 'u':
+        if (!marker) {
+            cursor       = saved_cursor;
+            current_attr = saved_attr;
+        }
+        break;
+    case 'h':
+    case 'l':
+        if (marker == '?' && std::find(params.begin(), params.end(), 69) != params.end()) {
+            lr_margin_mode = (seq.back() == 'h');
+            margin_left    = 0;
+            margin_right   = term_cols - 1;
+        }
+        break;
+    case 'L':
+    case 'M':
+        if (cursor.row >= margin_top && cursor.row <= margin_bottom && in_column_margins()) {
+            scroll(cursor.row, margin_left, margin_bottom, margin_right,
+                   (seq.back() == 'L') ? -param(0, 1) : param(0, 1));
+            cursor.col = margin_left;
+        }
+        break;
+    case 'S':
+        scroll(margin_top, margin_left, margin_bottom, margin_right, param(0, 1));
+        break;
+    case 'T':
+        if (params.size() <= 1) {
+            scroll(margin_top, margin_left, margin_bottom, margin_right, -param(0, 1));
+        }
+        break;
+    case 'A':
+        cursor.row = std::max(0, cursor.row - param(0, 1));
+        break;
+    case 'B':
+        cursor.row = std::min(term_rows - 1, cursor.row + param(0, 1));
+        break;
+    case 'C':
+        cursor.col = std::min(term_cols - 1, cursor.col + param(0, 1));
+        break;
+    case 'D':
+        cursor.col = std::max(0, cursor.col - param(0, 1));
+        break;
+    case 'J':
+        switch (param(0, 0)) {
+        default:
+        case 0:
+            clear(cursor.row, cursor.col, term_cols);
+            for (int r = cursor.row + 1; r < term_rows; ++r) {
+                clear(r, 0, term_cols);
+            }
+            break;
+        case 1:
+            for (int r = 0; r < cursor.row; ++r) {
+                clear(r, 0, term_cols);
+            }
+            clear(cursor.row, 0, cursor.col + 1);
+            break;
+        case 2:
+            clear_screen();
+            break;
+        }
+        break;
+    case 'K':
+        switch (param(0, 0)) {
+        default:
+        case 0:
+            clear(cursor.row, cursor.col, term_cols);
+            break;
+        case 1:
+            clear(cursor.row, 0, cursor.col + 1);
+            break;
+        case 2:
+            clear(cursor.row, 0, term_cols);
+            break;
+        }
+        break;
+    }
+}
+
+void ReferenceLogic::clear_screen()
+{
+    for (auto &line : text_buffer) {
+        line.assign(term_cols, { L' ', current_attr });
+    }
+    cursor = {};
+}
+
+void ReferenceLogic::reset_margins()
+{
+    margin_top     = 0;
+    margin_bottom  = term_rows - 1;
+    margin_left    = 0;
+    margin_right   = term_cols - 1;
+    lr_margin_mode = false;
+}
+
+//
+// Scroll area up by count rows, or down when negative, one row at a time.
+//
+void ReferenceLogic::scroll(int top, int left, int bottom, int right, int count)
+{
+    for (int n = std::min(std::abs(count), bottom - top + 1); n > 0; --n) {
+        for (int k = 0; k < bottom - top; ++k) {
+            int dst = (count > 0) ? top + k : bottom - k;
+            int src = (count > 0) ? dst + 1 : dst - 1;
+            for (int c = left; c <= right; ++c) {
+                text_buffer[dst][c] = text_buffer[src][c];
+            }
+        }
+        auto &line = text_buffer[(count > 0) ? bottom : top];
+        std::fill(line.begin() + left, line.begin() + right + 1, Char{ L' ', current_attr });
+    }
+}
@@ -0,0 +1,79 @@
+//
+// Reference model of the ANSI logic, for differential tests.
+//
+// Copyright (c) 2025 Serge Vakulenko
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef REFERENCE_LOGIC_H
+#define REFERENCE_LOGIC_H
+
+#include <string>
+#include <vector>
+
+#include "ansi_logic.h"
+
+//
+// Straightforward byte-at-a-time implementation of the terminal logic.
+// Fast paths in AnsiLogic must produce exactly the same screen,
+// cursor and attributes. Used only by unit tests.
+//
+class ReferenceLogic {
+public:
+    ReferenceLogic(int cols, int rows);
+    void process_input(const char *buffer, size_t length);
+    const std::vector<std::vector<Char>> &get_text_buffer() const { return text_buffer; }
+    const Cursor &get_cursor() const { return cursor; }
+    const CharAttr &get_attr() const { return current_attr; }
+
+private:
+    // Terminal state
+    int term_cols;
+    int term_rows;
+    std::vector<std::vector<Char>> text_buffer;
+    Cursor cursor;
+    CharAttr current_attr;
+    AnsiState state{ AnsiState::NORMAL };
+    std::string ansi_seq;
+    wchar_t last_char{};
+
+    // Scrolling region, inclusive
+    int margin_top{};
+    int margin_bottom{};
+    int margin_left{};
+    int margin_right{};
+    bool lr_margin_mode{};
+
+    // Saved by DECSC or SCOSC
+    Cursor saved_cursor;
+    CharAttr saved_attr;
+
+    void put_char(wchar_t ch);
+    void line_feed();
+    void reverse_index();
+    void carriage_return();
+    bool in_column_margins() const;
+    int row_end() const;
+    void parse_ansi_sequence(const std::string &seq);
+    void clear_screen();
+    void reset_margins();
+    void scroll(int top, int left, int bottom, int right, int count);
+};
+
+#endif // REFERENCE_LOGIC_H
@@ -0,0 +1,164 @@
+//
+// Reflow of text for a new screen width.
+//
+// Copyright (c) 2025 Serge Vakulenko
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include "reflow.h"
+
+#include "ansi_logic.h"
+
+#include <algorithm>
+#include <thread>
+
+void parallel_for(size_t count, size_t min_chunk,
+                  const std::function<void(size_t begin, size_t end)> &func)
+{
+    size_t threads = std::max(1u, std::thread::hardware_concurrency());
+    size_t chunk   = std::max(min_chunk, (count + threads - 1) / threads);
+
+    // Current thread takes the first chunk.
+    std::vector<std::thread> workers;
+    for (size_t begin = chunk; begin < count; begin += chunk) {
+        workers.emplace_back(func, begin, std::min(count, begin + chunk));
+    }
+    func(0, std::min(count, chunk));
+    for (auto &worker : workers) {
+        worker.join();
+    }
+}
+
+void ReflowIndex::build(const std::pmr::vector<Line> &rows, const std::vector<bool> &wraps,
+                        int old_width, int new_width, int64_t cursor_row, int cursor_col)
+{
+    old_cols = std::max(old_width, 1);
+    new_cols = std::max(new_width, 1);
+
+    // Logical lines end at rows which are not wrapped.
+    old_start.assign(1, 0);
+    for (size_t r = 0; r < rows.size(); ++r) {
+        if (!wraps[r] || r + 1 == rows.size()) {
+            old_start.push_back(r + 1);
+        }
+    }
+    size_t count = old_start.size() - 1;
+    length.assign(count, 0);
+    new_start.assign(count + 1, 0);
+
+    // Lengths and numbers of new rows are independent for every logical line.
+    parallel_for(count, min_chunk, [&](size_t begin, size_t end) {
+        for (size_t n = begin; n < end; ++n) {
+            int64_t last        = old_start[n + 1] - 1;
+            const Line &text    = rows[last];
+            int64_t tail        = std::min<int64_t>(text.size(), old_cols);
+            while (tail > 0 && text[tail - 1].ch == L' ') {
+                --tail;
+            }
+            int64_t len = (last - old_start[n]) * old_cols + tail;
+            if (cursor_row >= old_start[n] && cursor_row <= last) {
+                len = std::max(len, (cursor_row - old_start[n]) * old_cols + cursor_col);
+            }
+            length[n]        = len;
+            new_start[n + 1] = std::max<int64_t>(1, (len + new_cols - 1) / new_cols);
+        }
+    });
+    for (size_t n = 0; n < count; ++n) {
+        new_start[n + 1] += new_start[n];
+    }
+}
+
+size_t ReflowIndex::find_old(int64_t row) const
+{
+    return std::upper_bound(old_start.begin(), old_start.end() - 1, row) - old_start.begin() - 1;
+}
+
+size_t ReflowIndex::find_new(int64_t row) const
+{
+    return std::upper_bound(new_start.begin(), new_start.end() - 1, row) - new_start.begin() - 1;
+}
+
+void ReflowIndex::map(int64_t row, int col, int64_t &new_row, int &new_col) const
+{
+    if (row < 0) {
+        // Above the text: not moved.
+        new_row = row;
+        new_col = std::min(col, new_cols - 1);
+        return;
+    }
+    if (length.empty() || row >= get_old_rows()) {
+        // Below the text: rows keep their distance from its end.
+        new_row = get_new_rows() + row - get_old_rows();
+        new_col = std::min(col, new_cols - 1);
+        return;
+    }
+    size_t n       = find_old(row);
+    int64_t offset = (row - old_start[n]) * old_cols + col;
+    int64_t rows   = new_start[n + 1] - new_start[n];
+    int64_t r      = std::min(offset / new_cols, rows - 1);
+    new_row        = new_start[n] + r;
+    new_col        = std::min<int64_t>(offset - r * new_cols, new_cols - 1);
+}
+
+bool ReflowIndex::is_wrapped(int64_t new_row) const
+{
+    return new_row + 1 < new_start[find_new(new_row) + 1];
+}
+
+//
+// Blank with the attribute of the last cell of a row.
+//
+static Char trailing_blank(const Line &text)
+{
+    Char blank;
+    if (!text.empty()) {
+        blank.attr = text.back().attr;
+    }
+    return blank;
+}
+
+void ReflowIndex::fill(const std::pmr::vector<Line> &rows, int64_t first, int64_t last,
+                       Line *out) const
+{
+    if (first >= last)
+        return;
+    size_t n = find_new(first);
+    for (int64_t k = first; k < last; ++k, ++out) {
+        while (k >= new_start[n + 1]) {
+            ++n;
+        }
+
+        // Copy a piece of logical line, in runs from old rows.
+        // Blanks past the text keep the attribute of its last cell,
+        // so a background color extends to the end of the row.
+        int64_t offset = (k - new_start[n]) * new_cols;
+        int64_t end    = std::min(offset + new_cols, length[n]);
+        out->clear();
+        while (offset < end) {
+            const Line &text = rows[old_start[n] + offset / old_cols];
+            int64_t col      = offset % old_cols;
+            int64_t run      = std::min(end - offset, old_cols - col);
+            int64_t avail    = std::clamp<int64_t>(text.size() - col, 0, run);
+            out->insert(out->end(), text.begin() + col, text.begin() + col + avail);
+            out->resize(out->size() + run - avail, trailing_blank(text));
+            offset += run;
+        }
+        out->resize(new_cols, trailing_blank(rows[old_start[n + 1] - 1]));
+    }
+}
@@ -0,0 +1,85 @@
+//
+// Reflow of text for a new screen width.
+//
+// Copyright (c) 2025 Serge Vakulenko
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef REFLOW_H
+#define REFLOW_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory_resource>
+#include <vector>
+
+// Row of text, as defined in ansi_logic.h
+struct Char;
+using Line = std::pmr::vector<Char>;
+
+//
+// Index of logical lines: every logical line is a run of rows joined by soft wrap.
+// For each of them the index keeps its first row in the old layout, its first row
+// in the new layout, and its length. Rows are mapped between layouts by binary
+// search on these prefix sums, so only the rows actually needed are ever built.
+//
+class ReflowIndex {
+public:
+    // Split old rows into logical lines, and lay them out for the new width.
+    // Logical line with the cursor is extended up to the cursor,
+    // so the cursor stays after the text.
+    void build(const std::pmr::vector<Line> &rows, const std::vector<bool> &wraps, int old_cols,
+               int new_cols, int64_t cursor_row, int cursor_col);
+
+    size_t get_line_count() const { return length.size(); }
+    int64_t get_old_rows() const { return old_start.back(); }
+    int64_t get_new_rows() const { return new_start.back(); }
+
+    // Position in new layout for a position in old layout.
+    // Rows above the text, which are negative, are not moved.
+    void map(int64_t row, int col, int64_t &new_row, int &new_col) const;
+
+    // New row continues on the next one.
+    bool is_wrapped(int64_t new_row) const;
+
+    // Build new rows [first, last) from old rows. Output rows must have
+    // capacity for the new width: they are filled without allocation,
+    // so disjoint ranges can be built by different threads.
+    void fill(const std::pmr::vector<Line> &rows, int64_t first, int64_t last, Line *out) const;
+
+    // Logical lines per thread, below which the work is not split.
+    static const size_t min_chunk = 4096;
+
+private:
+    int old_cols{ 1 };
+    int new_cols{ 1 };
+    std::vector<int64_t> old_start{ 0 }; // Per logical line, plus total at the end
+    std::vector<int64_t> new_start{ 0 }; // Same, for new layout
+    std::vector<int64_t> length;         // Characters, without trailing blanks
+
+    size_t find_old(int64_t row) const;
+    size_t find_new(int64_t row) const;
+};
+
+// Run function on chunks of range [0, count), in parallel on all CPUs.
+void parallel_for(size_t count, size_t min_chunk,
+                  const std::function<void(size_t begin, size_t end)> &func);
+
+#endif // REFLOW_H
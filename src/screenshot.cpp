@@ -0,0 +1,293 @@
+//
+// Headless rendering of terminal screens into PNG files.
+//
+// Copyright (c) 2025 Serge Vakulenko
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include "screenshot.h"
+
+#include "png_writer.h"
+
+#include <errno.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <pty.h>
+#else
+#include <util.h>
+#endif
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+static std::string wchar_to_utf8(wchar_t wc)
+{
+    std::string utf8;
+    if (wc <= 0x7F) {
+        utf8 += static_cast<char>(wc);
+    } else if (wc <= 0x7FF) {
+        utf8 += static_cast<char>(0xC0 | ((wc >> 6) & 0x1F));
+        utf8 += static_cast<char>(0x80 | (wc & 0x3F));
+    } else if (wc <= 0xFFFF) {
+        utf8 += static_cast<char>(0xE0 | ((wc >> 12) & 0x0F));
+        utf8 += static_cast<char>(0x80 | ((wc >> 6) & 0x3F));
+        utf8 += static_cast<char>(0x80 | (wc & 0x3F));
+    } else {
+        utf8 += static_cast<char>(0xF0 | ((wc >> 18) & 0x07));
+        utf8 += static_cast<char>(0x80 | ((wc >> 12) & 0x3F));
+        utf8 += static_cast<char>(0x80 | ((wc >> 6) & 0x3F));
+        utf8 += static_cast<char>(0x80 | (wc & 0x3F));
+    }
+    return utf8;
+}
+
+HeadlessRenderer::HeadlessRenderer(const std::string &font_path, int font_size)
+{
+    if (TTF_Init() < 0) {
+        std::cerr << "TTF_Init failed: " << TTF_GetError() << std::endl;
+        return;
+    }
+    font = TTF_OpenFont(font_path.c_str(), font_size);
+    if (!font) {
+        std::cerr << "Failed to load font: " << TTF_GetError() << std::endl;
+        return;
+    }
+    TTF_SizeText(font, "M", &char_width, &char_height);
+}
+
+HeadlessRenderer::~HeadlessRenderer()
+{
+    clear_glyphs();
+    if (renderer)
+        SDL_DestroyRenderer(renderer);
+    if (surface)
+        SDL_FreeSurface(surface);
+    if (font)
+        TTF_CloseFont(font);
+    TTF_Quit();
+}
+
+void HeadlessRenderer::clear_glyphs()
+{
+    for (auto &item : glyphs) {
+        if (item.second)
+            SDL_DestroyTexture(item.second);
+    }
+    glyphs.clear();
+}
+
+//
+// Allocate surface for the screen of given size.
+// Textures belong to the renderer, so they are dropped with it.
+//
+bool HeadlessRenderer::resize(int cols, int rows)
+{
+    int width  = cols * char_width;
+    int height = rows * char_height;
+    if (surface && surface->w == width && surface->h == height)
+        return true;
+
+    clear_glyphs();
+    if (renderer)
+        SDL_DestroyRenderer(renderer);
+    if (surface)
+        SDL_FreeSurface(surface);
+    renderer = nullptr;
+
+    surface = SDL_CreateRGBSurfaceWithFormat(0, width, height, 32, SDL_PIXELFORMAT_ARGB8888);
+    if (!surface) {
+        std::cerr << "Cannot create surface: " << SDL_GetError() << std::endl;
+        return false;
+    }
+    renderer = SDL_CreateSoftwareRenderer(surface);
+    if (!renderer) {
+        std::cerr << "Cannot create renderer: " << SDL_GetError() << std::endl;
+        return false;
+    }
+    pixels.resize(width * height * 3);
+    return true;
+}
+
+//
+// Get texture of a glyph in given color, rendering it on first use.
+//
+SDL_Texture *HeadlessRenderer::get_glyph(wchar_t ch, const RgbColor &fg)
+{
+    uint64_t key = (static_cast<uint64_t>(ch) << 24) | (fg.r << 16) | (fg.g << 8) | fg.b;
+    auto it      = glyphs.find(key);
+    if (it != glyphs.end())
+        return it->second;
+
+    SDL_Texture *texture = nullptr;
+    SDL_Color color      = { fg.r, fg.g, fg.b, 255 };
+    SDL_Surface *glyph   = TTF_RenderUTF8_Blended(font, wchar_to_utf8(ch).c_str(), color);
+    if (glyph) {
+        texture = SDL_CreateTextureFromSurface(renderer, glyph);
+        SDL_FreeSurface(glyph);
+    }
+    glyphs[key] = texture;
+    return texture;
+}
+
+bool HeadlessRenderer::save_png(const AnsiLogic &display, const std::string &filename)
+{
+    if (!is_ready() || !resize(display.get_cols(), display.get_rows()))
+        return false;
+
+    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
+    SDL_RenderClear(renderer);
+
+    const auto &text_buffer = display.get_text_buffer();
+    for (int row = 0; row < display.get_rows(); ++row) {
+        for (int col = 0; col < display.get_cols(); ++col) {
+            const auto &c = text_buffer[row][col];
+            SDL_Rect cell = { col * char_width, row * char_height, char_width, char_height };
+            if (!(c.attr.bg == RgbColor(0, 0, 0))) {
+                SDL_SetRenderDrawColor(renderer, c.attr.bg.r, c.attr.bg.g, c.attr.bg.b, 255);
+                SDL_RenderFillRect(renderer, &cell);
+            }
+            if (c.ch == L' ')
+                continue;
+
+            SDL_Texture *texture = get_glyph(c.ch, c.attr.fg);
+            if (texture) {
+                SDL_QueryTexture(texture, nullptr, nullptr, &cell.w, &cell.h);
+                SDL_RenderCopy(renderer, texture, nullptr, &cell);
+            }
+        }
+    }
+
+    if (SDL_RenderReadPixels(renderer, nullptr, SDL_PIXELFORMAT_RGB24, pixels.data(),
+                             surface->w * 3) < 0) {
+        std::cerr << "Cannot read pixels: " << SDL_GetError() << std::endl;
+        return false;
+    }
+    if (!write_png(filename, pixels.data(), surface->w, surface->h, surface->w * 3)) {
+        std::cerr << filename << ": " << strerror(errno) << std::endl;
+        return false;
+    }
+    return true;
+}
+
+static bool read_file(const std::string &filename, std::string &data)
+{
+    std::ifstream file(filename, std::ios::binary);
+    if (!file) {
+        std::cerr << filename << ": " << strerror(errno) << std::endl;
+        return false;
+    }
+    std::ostringstream contents;
+    contents << file.rdbuf();
+    data = contents.str();
+    return true;
+}
+
+//
+// Run command on a pseudo-terminal of given size, and collect its output until exit.
+//
+static bool capture_command(const std::string &command, int cols, int rows, std::string &data)
+{
+    struct winsize ws = {};
+    ws.ws_col         = cols;
+    ws.ws_row         = rows;
+    int master_fd;
+    pid_t pid = forkpty(&master_fd, nullptr, nullptr, &ws);
+    if (pid < 0) {
+        std::cerr << "Cannot create pseudo-terminal: " << strerror(errno) << std::endl;
+        return false;
+    }
+    if (pid == 0) {
+        execl("/bin/sh", "sh", "-c", command.c_str(), nullptr);
+        _exit(127);
+    }
+
+    char buffer[4096];
+    for (;;) {
+        ssize_t bytes = read(master_fd, buffer, sizeof(buffer));
+        if (bytes > 0) {
+            data.append(buffer, bytes);
+        } else if (bytes < 0 && errno == EINTR) {
+            continue;
+        } else {
+            break; // EIO when the command has exited
+        }
+    }
+    close(master_fd);
+    int status;
+    waitpid(pid, &status, 0);
+    return true;
+}
+
+//
+// Replay output into a fresh screen, and save frames at given byte offsets
+// and at the end: name-OFFSET.png and name.png.
+//
+static bool replay(HeadlessRenderer &renderer, const ScreenshotOptions &options,
+                   const std::string &data, const std::string &name)
+{
+    AnsiLogic display(options.cols, options.rows);
+    std::string prefix = options.output_dir + "/" + name;
+    size_t pos         = 0;
+    for (size_t point : options.points) {
+        if (point > data.size())
+            break;
+        display.process_input(&data[pos], point - pos);
+        pos = point;
+        if (!renderer.save_png(display, prefix + "-" + std::to_string(point) + ".png"))
+            return false;
+    }
+    display.process_input(&data[pos], data.size() - pos);
+    return renderer.save_png(display, prefix + ".png");
+}
+
+int run_screenshots(const ScreenshotOptions &options, const std::string &font_path)
+{
+    HeadlessRenderer renderer(font_path, 16);
+    if (!renderer.is_ready())
+        return 1;
+
+    ScreenshotOptions sorted = options;
+    std::sort(sorted.points.begin(), sorted.points.end());
+    sorted.points.erase(std::unique(sorted.points.begin(), sorted.points.end()),
+                        sorted.points.end());
+
+    int status = 0;
+    for (const auto &filename : options.files) {
+        std::string data;
+        std::string name = filename.substr(filename.find_last_of('/') + 1);
+        name             = name.substr(0, name.find_last_of('.'));
+        if (!read_file(filename, data) || !replay(renderer, sorted, data, name)) {
+            status = 1;
+        }
+    }
+    for (size_t i = 0; i < options.commands.size(); ++i) {
+        std::string data;
+        std::string name = "command-" + std::to_string(i + 1);
+        if (!capture_command(options.commands[i], options.cols, options.rows, data) ||
+            !replay(renderer, sorted, data, name)) {
+            status = 1;
+        }
+    }
+    return status;
+}
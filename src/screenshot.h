@@ -0,0 +1,75 @@
+//
+// Headless rendering of terminal screens into PNG files.
+//
+// Copyright (c) 2025 Serge Vakulenko
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef SCREENSHOT_H
+#define SCREENSHOT_H
+
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_ttf.h>
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "ansi_logic.h"
+
+// Options of batch screenshot mode
+struct ScreenshotOptions {
+    std::string output_dir{ "." };
+    int cols{ 80 };
+    int rows{ 24 };
+    std::vector<size_t> points;        // Byte offsets of extra frames
+    std::vector<std::string> files;    // Recordings to replay
+    std::vector<std::string> commands; // Commands to run, output is captured
+};
+
+//
+// Renderer into memory surface, without window.
+// Font and glyph textures are loaded once and reused for all screenshots.
+//
+class HeadlessRenderer {
+public:
+    HeadlessRenderer(const std::string &font_path, int font_size);
+    ~HeadlessRenderer();
+    bool is_ready() const { return font != nullptr; }
+    bool save_png(const AnsiLogic &display, const std::string &filename);
+
+private:
+    TTF_Font *font{};
+    int char_width{};
+    int char_height{};
+    SDL_Surface *surface{};
+    SDL_Renderer *renderer{};
+    std::unordered_map<uint64_t, SDL_Texture *> glyphs; // By character and color
+    std::vector<uint8_t> pixels;
+
+    bool resize(int cols, int rows);
+    SDL_Texture *get_glyph(wchar_t ch, const RgbColor &fg);
+    void clear_glyphs();
+};
+
+// Render all inputs; return exit code.
+int run_screenshots(const ScreenshotOptions &options, const std::string &font_path);
+
+#endif // SCREENSHOT_H
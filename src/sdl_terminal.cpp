@@ -23,33 +23,61 @@
 //
 #include "sdl_terminal.h"
 
+#include "memory_governor.h"
+
 #include <errno.h>
 #include <fcntl.h>
 #include <signal.h>
 #include <sys/ioctl.h>
+#include <sys/resource.h>
 #include <sys/select.h>
 #include <sys/wait.h>
 #include <termios.h>
 #include <unistd.h>
 
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+#ifdef __APPLE__
+#include <mach/mach.h>
+#endif
+
+#include <algorithm>
+#include <iomanip>
 #include <iostream>
+#include <unordered_set>
 #include <codecvt>
 
 // Static signal handler context
 static SdlTerminal *terminal_instance = nullptr;
 
-SdlTerminal::SdlTerminal(int cols, int rows) : display(cols, rows)
+// Set by SIGWINCH, picked up by the main loop
+static volatile sig_atomic_t window_size_changed = 0;
+
+#ifndef TERMINFO_DIR
+#define TERMINFO_DIR "/usr/local/share/terminfo"
+#endif
+
+SdlTerminal::SdlTerminal(int cols, int rows, Clock &c) : clock(c), scheduler(c), display(cols, rows)
 {
     terminal_instance = this;
+    font_path         = default_font_path();
+}
+
+const char *SdlTerminal::default_font_path()
+{
 #ifdef __APPLE__
-    font_path = "/System/Library/Fonts/Menlo.ttc";
+    return "/System/Library/Fonts/Menlo.ttc";
 #else
-    font_path = "/usr/share/fonts/truetype/dejavu/DejaVuSansMono.ttf";
+    return "/usr/share/fonts/truetype/dejavu/DejaVuSansMono.ttf";
 #endif
 }
 
 SdlTerminal::~SdlTerminal()
 {
+    MemoryGovernor::instance().remove_client(history_client);
+    MemoryGovernor::instance().remove_client(glyph_client);
+    MemoryGovernor::instance().remove_client(image_client);
     if (child_pid > 0) {
         kill(child_pid, SIGTERM);
         int status;
@@ -57,12 +85,16 @@ SdlTerminal::~SdlTerminal()
     }
     if (master_fd != -1)
         close(master_fd);
-    for (auto &line_spans : texture_cache) {
-        for (auto &span : line_spans) {
-            if (span.texture)
-                SDL_DestroyTexture(span.texture);
-        }
+    clear_texture_cache();
+    for (auto &entry : image_textures) {
+        SDL_DestroyTexture(entry.second.texture);
     }
+    if (audio_device)
+        SDL_CloseAudioDevice(audio_device);
+    if (hand_cursor)
+        SDL_FreeCursor(hand_cursor);
+    if (arrow_cursor)
+        SDL_FreeCursor(arrow_cursor);
     if (renderer)
         SDL_DestroyRenderer(renderer);
     if (window)
@@ -87,7 +119,45 @@ bool SdlTerminal::initialize()
 
     texture_cache.resize(get_rows());
     dirty_lines.resize(get_rows(), true);
+    grid_stale.resize(get_rows(), true);
+    display.set_scroll_damage(true);
+    if (triggers.get_pattern_count() > 0) {
+        display.set_row_handler([this](int64_t line, const Line &text, bool wrap) {
+            check_triggers(line, text, wrap);
+        });
+    }
 
+    // Scrollback can shrink under memory pressure.
+    // Textures of visible window are its working set, so only hidden window drops them.
+    auto &governor = MemoryGovernor::instance();
+    history_client = governor.add_client(
+        "history", MemoryGovernor::Kind::HISTORY, [this] { return display.memory_in_use(); },
+        [this](size_t bytes) { return display.drop_history(bytes); });
+    glyph_client = governor.add_client(
+        "glyphs", MemoryGovernor::Kind::GLYPH_CACHE, [this] { return texture_bytes; },
+        [this](size_t) -> size_t {
+            if (!window_hidden)
+                return 0;
+            size_t released = texture_bytes;
+            clear_texture_cache();
+            dirty_lines.assign(get_rows(), true);
+            return released;
+        });
+
+    // Images keep textures of visible ones, or none when hidden;
+    // then images scrolled into history are dropped.
+    image_client = governor.add_client(
+        "images", MemoryGovernor::Kind::IMAGE_CACHE,
+        [this] { return display.image_memory_in_use() + image_texture_bytes; },
+        [this](size_t bytes) {
+            int64_t top     = (view_line >= 0) ? view_line : display.screen_line(0);
+            size_t released = window_hidden ? drop_image_textures(0, 0)
+                                            : drop_image_textures(top, top + get_rows());
+            if (released < bytes) {
+                released += display.drop_images(bytes - released);
+            }
+            return released;
+        });
     return true;
 }
 
@@ -113,6 +183,7 @@ bool SdlTerminal::initialize_sdl()
         std::cerr << "Failed to get font metrics" << std::endl;
         return false;
     }
+    display.set_cell_size(char_width, char_height);
 
     window = SDL_CreateWindow("Terminal Emulator", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED,
                               get_cols() * char_width, get_rows() * char_height,
@@ -124,14 +195,53 @@ bool SdlTerminal::initialize_sdl()
     }
 
     renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED);
+    if (!renderer) {
+        // No GPU, for example with dummy video driver.
+        renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_SOFTWARE);
+    }
     if (!renderer) {
         std::cerr << "SDL_CreateRenderer failed: " << SDL_GetError() << std::endl;
         return false;
     }
 
+    if (audible_bell) {
+        initialize_audio();
+    }
     return true;
 }
 
+//
+// Open audio device and prepare the bell sound: short beep with decay.
+// Without audio, the bell is only visible.
+//
+void SdlTerminal::initialize_audio()
+{
+    if (SDL_InitSubSystem(SDL_INIT_AUDIO) < 0) {
+        std::cerr << "Cannot initialize audio: " << SDL_GetError() << std::endl;
+        return;
+    }
+
+    SDL_AudioSpec want{}, have{};
+    want.freq     = 22050;
+    want.format   = AUDIO_S16SYS;
+    want.channels = 1;
+    want.samples  = 512;
+    audio_device  = SDL_OpenAudioDevice(nullptr, 0, &want, &have, 0);
+    if (!audio_device) {
+        std::cerr << "Cannot open audio device: " << SDL_GetError() << std::endl;
+        return;
+    }
+
+    const int samples = have.freq / 12; // 80 msec
+    const int period  = have.freq / 880;
+    bell_sound.resize(samples);
+    for (int i = 0; i < samples; ++i) {
+        int level     = 8000 * (samples - i) / samples;
+        bell_sound[i] = (i % period < period / 2) ? level : -level;
+    }
+    SDL_PauseAudioDevice(audio_device, 0);
+}
+
 bool SdlTerminal::initialize_pty(struct termios &slave_termios, char *&slave_name)
 {
     master_fd = posix_openpt(O_RDWR | O_NOCTTY);
@@ -151,7 +261,18 @@ bool SdlTerminal::initialize_pty(struct termios &slave_termios, char *&slave_nam
         return false;
     }
 
-    tcgetattr(STDIN_FILENO, &slave_termios);
+    if (tcgetattr(STDIN_FILENO, &slave_termios) == -1) {
+        // Not started from a terminal: take default settings of the slave.
+        int slave_fd = open(slave_name, O_RDWR | O_NOCTTY);
+        if (slave_fd == -1 || tcgetattr(slave_fd, &slave_termios) == -1) {
+            std::cerr << "Error getting slave attributes: " << strerror(errno) << std::endl;
+            if (slave_fd != -1)
+                close(slave_fd);
+            close(master_fd);
+            return false;
+        }
+        close(slave_fd);
+    }
     slave_termios.c_lflag |= ISIG;
     slave_termios.c_iflag |= ICRNL;
     slave_termios.c_oflag |= OPOST | ONLCR;
@@ -160,6 +281,30 @@ bool SdlTerminal::initialize_pty(struct termios &slave_termios, char *&slave_nam
     return true;
 }
 
+//
+// Tell the child which capabilities the terminal has: use its own terminfo entry,
+// when it's installed, or compiled into ~/.terminfo. Otherwise TERM is inherited.
+//
+static void set_terminal_type()
+{
+    static const char name[] = "terminal-emulator";
+    auto has_entry           = [](const std::string &dir) {
+        // Directory tree is by first letter, or by its hex code on macOS.
+        return access((dir + "/t/" + name).c_str(), R_OK) == 0 ||
+               access((dir + "/74/" + name).c_str(), R_OK) == 0;
+    };
+    const char *home = getenv("HOME");
+    if (home && has_entry(std::string(home) + "/.terminfo")) {
+        setenv("TERM", name, 1);
+    } else if (has_entry(TERMINFO_DIR)) {
+        // Empty entry at the end stands for the system directories.
+        const char *dirs = getenv("TERMINFO_DIRS");
+        std::string path = std::string(TERMINFO_DIR) + ":" + (dirs ? dirs : "");
+        setenv("TERMINFO_DIRS", path.c_str(), 1);
+        setenv("TERM", name, 1);
+    }
+}
+
 bool SdlTerminal::initialize_child_process(const char *slave_name,
                                                const struct termios &slave_termios)
 {
@@ -195,6 +340,14 @@ bool SdlTerminal::initialize_child_process(const char *slave_name,
         if (slave_fd > 2)
             close(slave_fd);
 
+        if (!bench_workloads.empty()) {
+            // Output of the generator must reach the terminal unchanged.
+            struct termios raw = slave_termios;
+            raw.c_oflag &= ~OPOST;
+            tcsetattr(STDOUT_FILENO, TCSANOW, &raw);
+            run_generator();
+        }
+        set_terminal_type();
         execl("/bin/sh", "sh", nullptr);
         std::cerr << "Error executing shell: " << strerror(errno) << std::endl;
         _exit(1);
@@ -214,34 +367,259 @@ bool SdlTerminal::initialize_child_process(const char *slave_name,
     return true;
 }
 
+//
+// Benchmark child: write all workloads into the terminal as fast as possible.
+// Then wait to be killed, so the output is not lost when the slave side closes.
+//
+void SdlTerminal::run_generator() const
+{
+    for (const auto &workload : bench_workloads) {
+        const char *data = workload.output.data();
+        size_t left      = workload.output.size();
+        while (left > 0) {
+            ssize_t written = write(STDOUT_FILENO, data, left);
+            if (written < 0) {
+                if (errno == EINTR)
+                    continue;
+                _exit(1);
+            }
+            data += written;
+            left -= written;
+        }
+    }
+    for (;;) {
+        pause();
+    }
+}
+
 void SdlTerminal::run()
 {
-    bool running = true;
-    while (running) {
-        handle_events();
-        process_pty_input();
-        render_text();
+    while (run_once()) {
+        continue;
+    }
+}
 
-        int status;
-        if (waitpid(child_pid, &status, WNOHANG) > 0) {
-            running = false;
+//
+// One iteration of the main loop.
+// Return false when the child process has finished.
+//
+bool SdlTerminal::run_once()
+{
+    loop_iterations++;
+    handle_events();
+    process_pty_input();
+    std::string data;
+    while (!scroll_lock && delayed_output.pop(clock.now_ms(), data)) {
+        handle_output(data.data(), data.size());
+    }
+
+    if (window_size_changed) {
+        window_size_changed = 0;
+        int win_width, win_height;
+        SDL_GetWindowSize(window, &win_width, &win_height);
+        scheduler.request_resize(std::max(win_width / char_width, 1),
+                                 std::max(win_height / char_height, 1));
+    }
+    int cols, rows;
+    if (scheduler.take_resize(cols, rows)) {
+        resize_terminal(cols, rows);
+    }
+    if (scheduler.is_idle()) {
+        trim_memory();
+    }
+    render_text();
+
+    int status;
+    return waitpid(child_pid, &status, WNOHANG) <= 0;
+}
+
+//
+// Let the terminal sit idle with a shell for a given time, and measure
+// main loop wakeups, frames presented and CPU time per idle second.
+// Return false when any of them exceeds the limit.
+//
+bool SdlTerminal::run_idle_test(unsigned seconds)
+{
+    // Limits per idle second.
+    static const double max_iterations = 110; // Polling tick is 10 msec
+    static const double max_frames     = 3;   // Cursor blinks twice per second
+    static const double max_cpu_time   = 0.02;
+
+    // Let the shell print its prompt, then start measuring.
+    uint64_t warmup_end = clock.now_ms() + 1000;
+    while (clock.now_ms() < warmup_end) {
+        if (!run_once()) {
+            std::cerr << "Child process exited during idle test" << std::endl;
+            return false;
+        }
+    }
+
+    struct rusage usage_start, usage_end;
+    getrusage(RUSAGE_SELF, &usage_start);
+    uint64_t iterations_start = loop_iterations;
+    uint64_t frames_start     = frames_presented;
+    uint64_t time_start       = clock.now_ms();
+    while (clock.now_ms() - time_start < seconds * 1000) {
+        if (!run_once()) {
+            std::cerr << "Child process exited during idle test" << std::endl;
+            return false;
         }
     }
+    double elapsed = (clock.now_ms() - time_start) / 1000.0;
+    getrusage(RUSAGE_SELF, &usage_end);
+
+    auto seconds_of = [](const struct timeval &tv) { return tv.tv_sec + tv.tv_usec / 1e6; };
+    double cpu_time = seconds_of(usage_end.ru_utime) - seconds_of(usage_start.ru_utime) +
+                      seconds_of(usage_end.ru_stime) - seconds_of(usage_start.ru_stime);
+    double switches = (usage_end.ru_nvcsw - usage_start.ru_nvcsw) +
+                      (usage_end.ru_nivcsw - usage_start.ru_nivcsw);
+    double iterations = (loop_iterations - iterations_start) / elapsed;
+    double frames     = (frames_presented - frames_start) / elapsed;
+
+    std::cout << "Per idle second, measured over " << elapsed << " seconds:\n";
+    std::cout << "    Loop iterations:  " << iterations << " (limit " << max_iterations << ")\n";
+    std::cout << "    Frames presented: " << frames << " (limit " << max_frames << ")\n";
+    std::cout << "    CPU time:         " << cpu_time / elapsed << " sec (limit " << max_cpu_time
+              << ")\n";
+    std::cout << "    Context switches: " << switches / elapsed << std::endl;
+
+    return iterations <= max_iterations && frames <= max_frames &&
+           cpu_time / elapsed <= max_cpu_time;
+}
+
+//
+// Throughput benchmark: the generator child pushes workloads through the PTY,
+// and the main loop parses and renders them as usual.
+// Report speed of every workload, and total time until the frame
+// with the end of output is presented.
+//
+bool SdlTerminal::run_bench()
+{
+    if (bench_perf && !perf.open()) {
+        std::cerr << "Hardware counters are not available, check perf_event_paranoid\n";
+    }
+
+    // Counters are summed over rendered frames, since given values.
+    auto report = [this](const std::string &name, uint64_t bytes, uint64_t msec, uint64_t frames,
+                         uint64_t skipped, const uint64_t *events_start) {
+        double seconds = std::max<uint64_t>(msec, 1) / 1000.0;
+        std::cout << std::left << std::setw(8) << name << std::right << std::fixed
+                  << std::setprecision(1) << std::setw(9) << bytes / seconds / 1e6 << " MB/s"
+                  << std::setw(8) << frames << " frames" << std::setw(8) << skipped
+                  << " skipped";
+        for (int e = 0; e < PerfCounters::NUM_EVENTS && frames > 0; ++e) {
+            uint64_t value;
+            if (perf.get(PerfCounters::Event(e), value)) {
+                std::cout << "  " << std::setprecision(0)
+                          << double(frame_events[e] - events_start[e]) / frames << " "
+                          << PerfCounters::name(PerfCounters::Event(e)) << "/frame";
+            }
+        }
+        std::cout << std::endl;
+    };
+
+    uint64_t time_start = clock.now_ms();
+    uint64_t total      = 0;
+    uint64_t no_events[PerfCounters::NUM_EVENTS]{};
+    for (const auto &workload : bench_workloads) {
+        // Boundaries between workloads are seen with the granularity of a parse slice.
+        uint64_t start         = clock.now_ms();
+        uint64_t frames_start  = frames_presented;
+        uint64_t skipped_start = frames_skipped;
+        uint64_t events_start[PerfCounters::NUM_EVENTS];
+        std::copy(std::begin(frame_events), std::end(frame_events), events_start);
+        total += workload.output.size();
+        while (bytes_received < total) {
+            if (!run_once()) {
+                std::cerr << "Generator exited during benchmark" << std::endl;
+                return false;
+            }
+        }
+        report(workload.name, workload.output.size(), clock.now_ms() - start,
+               frames_presented - frames_start, frames_skipped - skipped_start, events_start);
+    }
+
+    // Wait for the frame with the end of output.
+    uint64_t frames_before = frames_presented;
+    need_present           = true;
+    while (frames_presented == frames_before && !window_hidden) {
+        if (!run_once()) {
+            std::cerr << "Generator exited during benchmark" << std::endl;
+            return false;
+        }
+    }
+    report("total", total, clock.now_ms() - time_start, frames_presented, frames_skipped,
+           no_events);
+    return true;
 }
 
 void SdlTerminal::render_text()
 {
-    Uint32 current_time = SDL_GetTicks();
-    if (current_time - last_cursor_toggle >= cursor_blink_interval) {
-        cursor_visible     = !cursor_visible;
-        last_cursor_toggle = current_time;
+    if (scheduler.update_blink()) {
+        need_present = true;
+    }
+    if (scheduler.update_bell()) {
+        need_present = true;
+    }
+
+    // Nothing to do when the window is not visible,
+    // or when neither text nor cursor has changed.
+    // Changes coming faster than the frame rate are coalesced.
+    if (window_hidden)
+        return;
+    if (!need_present &&
+        std::find(dirty_lines.begin(), dirty_lines.end(), true) == dirty_lines.end())
+        return;
+    if (!scheduler.can_present()) {
+        frames_skipped++;
+        return;
+    }
+    if (perf.is_open()) {
+        perf.start();
     }
 
     update_texture_cache();
-    render_spans();
+    render_grid();
+
+    // Latch the echo of a key as late as possible:
+    // it may have arrived while the grid was drawn.
+    if (scheduler.is_input_pending() && read_pty()) {
+        update_texture_cache();
+        render_grid();
+    }
+
+    // Compose the frame: grid, overlays, and cursor on top.
+    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
+    SDL_RenderClear(renderer);
+    if (grid_texture) {
+        SDL_Rect rect = { 0, 0, get_cols() * char_width, get_rows() * char_height };
+        SDL_RenderCopy(renderer, grid_texture, nullptr, &rect);
+    } else {
+        for (int row = 0; row < get_rows(); ++row) {
+            render_row(row);
+        }
+    }
+    render_images();
+    render_highlights();
+    render_hover_link();
+    render_predictions();
     render_cursor();
+    render_scroll_lock();
+    render_bell();
 
     SDL_RenderPresent(renderer);
+    need_present = false;
+    frames_presented++;
+    scheduler.frame_presented();
+    if (perf.is_open()) {
+        perf.stop();
+        for (int e = 0; e < PerfCounters::NUM_EVENTS; ++e) {
+            uint64_t value;
+            if (perf.get(PerfCounters::Event(e), value)) {
+                frame_events[e] += value;
+            }
+        }
+    }
 }
 
 static std::string wstring_to_utf8(const std::wstring &wstr)
@@ -262,6 +640,93 @@ static std::string wstring_to_utf8(const std::wstring &wstr)
     return utf8;
 }
 
+//
+// Destroy all cached textures.
+// Lines must be marked dirty to get rendered again.
+//
+void SdlTerminal::clear_texture_cache()
+{
+    for (auto &line_spans : texture_cache) {
+        for (auto &span : line_spans) {
+            if (span.texture)
+                SDL_DestroyTexture(span.texture);
+        }
+        line_spans.clear();
+        line_spans.shrink_to_fit();
+    }
+    if (grid_texture) {
+        SDL_DestroyTexture(grid_texture);
+        grid_texture = nullptr;
+    }
+    if (grid_scratch) {
+        SDL_DestroyTexture(grid_scratch);
+        grid_scratch = nullptr;
+    }
+    grid_scrolls.clear();
+    texture_bytes = 0;
+}
+
+//
+// Get resident set size of this process, in bytes.
+//
+static size_t resident_memory()
+{
+#ifdef __linux__
+    long pages = 0, resident = 0;
+    FILE *f    = fopen("/proc/self/statm", "r");
+    if (f) {
+        if (fscanf(f, "%ld %ld", &pages, &resident) != 2)
+            resident = 0;
+        fclose(f);
+    }
+    return resident * sysconf(_SC_PAGESIZE);
+#elif defined(__APPLE__)
+    mach_task_basic_info_data_t info;
+    mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+    if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO, (task_info_t)&info, &count) !=
+        KERN_SUCCESS)
+        return 0;
+    return info.resident_size;
+#else
+    return 0;
+#endif
+}
+
+//
+// Release memory when the terminal is idle or hidden.
+// Visible window keeps textures of the screen; hidden one drops them all.
+// Done once per idle period.
+//
+void SdlTerminal::trim_memory()
+{
+    if (memory_trimmed)
+        return;
+    memory_trimmed = true;
+
+    size_t rss_before = resident_memory();
+    if (window_hidden) {
+        clear_texture_cache();
+        drop_image_textures(0, 0);
+        dirty_lines.assign(get_rows(), true);
+    }
+    display.trim_memory();
+#ifdef __GLIBC__
+    malloc_trim(0);
+#endif
+    size_t rss_after = resident_memory();
+
+    if (verbose) {
+        auto stats = MemoryGovernor::instance().get_stats();
+        std::cerr << "Memory budget: " << stats.usage / 1024 << " kbytes used, peak "
+                  << stats.peak_usage / 1024 << " kbytes, " << stats.evictions << " evictions, "
+                  << stats.bytes_evicted / 1024 << " kbytes evicted" << std::endl;
+        std::cerr << "Memory trimmed" << (window_hidden ? " (hidden)" : " (idle)") << ": RSS "
+                  << rss_before / 1024 << " kbytes before, " << rss_after / 1024
+                  << " kbytes after, session " << display.memory_reserved() / 1024 << " kbytes"
+                  << std::endl;
+    }
+}
+
 void SdlTerminal::update_texture_cache()
 {
     const auto &text_buffer = display.get_text_buffer();
@@ -270,35 +735,36 @@ void SdlTerminal::update_texture_cache()
         if (!dirty_lines[i])
             continue;
 
-        for (auto &span : texture_cache[i]) {
-            if (span.texture)
-                SDL_DestroyTexture(span.texture);
+        destroy_line_textures(i);
+        dirty_lines[i] = false;
+        grid_stale[i]  = true;
+        links.invalidate(i);
+
+        // In scrollback view, lines come from history and may have another width.
+        // In tmux control mode, rows are composed of panes.
+        const Line *line = &text_buffer[i];
+        Line composed;
+        if (tmux) {
+            composed = tmux->compose_row(i, get_cols());
+            line     = &composed;
+        } else if (view_line >= 0) {
+            line = display.get_line(view_line + i);
         }
-        texture_cache[i].clear();
+        int ncols = line ? std::min<int>(line->size(), get_cols()) : 0;
+        if (ncols == 0)
+            continue;
 
         std::wstring current_text;
-        CharAttr current_span_attr = text_buffer[i][0].attr;
+        CharAttr current_span_attr = (*line)[0].attr;
         int start_col              = 0;
 
-        for (int j = 0; j < get_cols(); ++j) {
-            const auto &c = text_buffer[i][j];
-            if (c.attr == current_span_attr && j < get_cols() - 1) {
+        for (int j = 0; j < ncols; ++j) {
+            const auto &c = (*line)[j];
+            if (c.attr == current_span_attr && j < ncols - 1) {
                 current_text += c.ch;
             } else {
                 if (!current_text.empty()) {
-                    TextSpan span;
-                    span.text      = current_text;
-                    span.attr      = current_span_attr;
-                    span.start_col = start_col;
-
-                    SDL_Color fg         = { current_span_attr.fg.r, current_span_attr.fg.g,
-                                             current_span_attr.fg.b, 255 };
-                    SDL_Surface *surface = TTF_RenderUTF8_Blended(font, wstring_to_utf8(current_text).c_str(), fg);
-                    if (surface) {
-                        span.texture = SDL_CreateTextureFromSurface(renderer, surface);
-                        SDL_FreeSurface(surface);
-                    }
-                    texture_cache[i].push_back(span);
+                    add_span(i, current_text, current_span_attr, start_col);
                 }
                 current_text      = c.ch;
                 current_span_attr = c.attr;
@@ -307,54 +773,196 @@ void SdlTerminal::update_texture_cache()
         }
 
         if (!current_text.empty()) {
-            TextSpan span;
-            span.text      = current_text;
-            span.attr      = current_span_attr;
-            span.start_col = start_col;
-
-            SDL_Color fg = { current_span_attr.fg.r, current_span_attr.fg.g, current_span_attr.fg.b,
-                             255 };
-            SDL_Surface *surface = TTF_RenderUTF8_Blended(font, wstring_to_utf8(current_text).c_str(), fg);
-            if (surface) {
-                span.texture = SDL_CreateTextureFromSurface(renderer, surface);
-                SDL_FreeSurface(surface);
-            }
-            texture_cache[i].push_back(span);
+            add_span(i, current_text, current_span_attr, start_col);
         }
+    }
 
-        dirty_lines[i] = false;
+    // Only changed rows are scanned for links.
+    if (view_line < 0 && !tmux) {
+        links.update(display);
     }
+    update_hover_link();
 }
 
-void SdlTerminal::render_spans()
+//
+// Render a span of text into texture, and append it to the line.
+//
+void SdlTerminal::add_span(int row, const std::wstring &text, const CharAttr &attr, int start_col)
 {
-    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
-    SDL_RenderClear(renderer);
-
-    for (size_t i = 0; i < texture_cache.size() && i < static_cast<size_t>(get_rows()); ++i) {
-        for (const auto &span : texture_cache[i]) {
-            if (!span.texture)
-                continue;
-
-            SDL_SetRenderDrawColor(renderer, span.attr.bg.r, span.attr.bg.g, span.attr.bg.b,
-                                   255);
-            SDL_Rect bg_rect = { span.start_col * char_width, static_cast<int>(i * char_height),
-                                 static_cast<int>(span.text.length() * char_width), char_height };
-            SDL_RenderFillRect(renderer, &bg_rect);
+    TextSpan span;
+    span.text      = text;
+    span.attr      = attr;
+    span.start_col = start_col;
+
+    SDL_Color fg         = { attr.fg.r, attr.fg.g, attr.fg.b, 255 };
+    SDL_Surface *surface = TTF_RenderUTF8_Blended(font, wstring_to_utf8(text).c_str(), fg);
+    if (surface) {
+        span.texture = SDL_CreateTextureFromSurface(renderer, surface);
+        if (span.texture) {
+            texture_bytes += surface->w * surface->h * 4;
+        }
+        SDL_FreeSurface(surface);
+    }
+    texture_cache[row].push_back(span);
+}
 
+void SdlTerminal::destroy_line_textures(int row)
+{
+    for (auto &span : texture_cache[row]) {
+        if (span.texture) {
             int w, h;
             SDL_QueryTexture(span.texture, nullptr, nullptr, &w, &h);
-            SDL_Rect dst = { span.start_col * char_width, static_cast<int>(i * char_height), w, h };
-            SDL_RenderCopy(renderer, span.texture, nullptr, &dst);
+            texture_bytes -= std::min<size_t>(texture_bytes, w * h * 4);
+            SDL_DestroyTexture(span.texture);
+        }
+    }
+    texture_cache[row].clear();
+}
+
+//
+// Redraw changed rows into the grid layer.
+// The grid is created on demand, and all rows are drawn into a new one.
+// Without render targets, rows are drawn directly into every frame.
+//
+void SdlTerminal::render_grid()
+{
+    int width  = get_cols() * char_width;
+    int height = get_rows() * char_height;
+    if (!grid_texture && SDL_RenderTargetSupported(renderer)) {
+        grid_texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA8888,
+                                         SDL_TEXTUREACCESS_TARGET, width, height);
+        if (grid_texture) {
+            texture_bytes += width * height * 4;
+            grid_stale.assign(get_rows(), true);
+        }
+    }
+    if (!grid_texture)
+        return;
+
+    for (const auto &scroll : grid_scrolls) {
+        scroll_grid(scroll);
+    }
+    grid_scrolls.clear();
+
+    SDL_SetRenderTarget(renderer, grid_texture);
+    for (int row = 0; row < get_rows(); ++row) {
+        if (grid_stale[row]) {
+            render_row(row);
+            grid_stale[row] = false;
+        }
+    }
+    SDL_SetRenderTarget(renderer, nullptr);
+}
+
+//
+// Rows of full width, scrolled by the terminal logic, keep their textures:
+// rows are moved, and only rows coming in are rendered.
+// Rows of partial width are rendered whole; they are already marked as changed.
+//
+void SdlTerminal::scroll_rows(const ScrollDamage &scroll)
+{
+    int height = scroll.bottom - scroll.top + 1;
+    int shift  = std::abs(scroll.count);
+    if (scroll.left != 0 || scroll.right != get_cols() - 1 || shift == 0)
+        return;
+    if (shift >= height) {
+        for (int row = scroll.top; row <= scroll.bottom; ++row) {
+            dirty_lines[row] = true;
         }
+        return;
+    }
+
+    auto rotate = [&scroll, shift](auto &rows) {
+        auto first = rows.begin() + scroll.top;
+        auto last  = rows.begin() + scroll.bottom + 1;
+        std::rotate(first, (scroll.count > 0) ? first + shift : last - shift, last);
+    };
+    rotate(texture_cache);
+    rotate(dirty_lines);
+    rotate(grid_stale);
+    int incoming = (scroll.count > 0) ? scroll.bottom - shift + 1 : scroll.top;
+    for (int row = incoming; row < incoming + shift; ++row) {
+        dirty_lines[row] = true;
+    }
+    for (int row = scroll.top; row <= scroll.bottom; ++row) {
+        links.invalidate(row);
+    }
+    if (grid_texture) {
+        grid_scrolls.push_back(scroll);
+    }
+}
+
+//
+// Move pixels of scrolled rows in the grid. A texture can't be copied onto itself,
+// so rows go to the scratch texture and back.
+//
+void SdlTerminal::scroll_grid(const ScrollDamage &scroll)
+{
+    int width  = get_cols() * char_width;
+    int height = get_rows() * char_height;
+    if (!grid_scratch) {
+        grid_scratch = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA8888,
+                                         SDL_TEXTUREACCESS_TARGET, width, height);
+        if (!grid_scratch) {
+            for (int row = scroll.top; row <= scroll.bottom; ++row) {
+                grid_stale[row] = true;
+            }
+            return;
+        }
+        texture_bytes += width * height * 4;
+    }
+
+    int shift     = std::abs(scroll.count);
+    int moved     = scroll.bottom - scroll.top + 1 - shift;
+    int from      = (scroll.count > 0) ? scroll.top + shift : scroll.top;
+    int to        = (scroll.count > 0) ? scroll.top : scroll.top + shift;
+    SDL_Rect src  = { 0, from * char_height, width, moved * char_height };
+    SDL_Rect dest = { 0, to * char_height, width, moved * char_height };
+    SDL_SetRenderTarget(renderer, grid_scratch);
+    SDL_RenderCopy(renderer, grid_texture, &src, &src);
+    SDL_SetRenderTarget(renderer, grid_texture);
+    SDL_RenderCopy(renderer, grid_scratch, &src, &dest);
+    SDL_SetRenderTarget(renderer, nullptr);
+}
+
+//
+// Draw one row of text with backgrounds.
+//
+void SdlTerminal::render_row(int row)
+{
+    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
+    SDL_Rect row_rect = { 0, row * char_height, get_cols() * char_width, char_height };
+    SDL_RenderFillRect(renderer, &row_rect);
+
+    for (const auto &span : texture_cache[row]) {
+        if (!span.texture)
+            continue;
+
+        SDL_SetRenderDrawColor(renderer, span.attr.bg.r, span.attr.bg.g, span.attr.bg.b, 255);
+        SDL_Rect bg_rect = { span.start_col * char_width, row * char_height,
+                             static_cast<int>(span.text.length() * char_width), char_height };
+        SDL_RenderFillRect(renderer, &bg_rect);
+
+        int w, h;
+        SDL_QueryTexture(span.texture, nullptr, nullptr, &w, &h);
+        SDL_Rect dst = { span.start_col * char_width, row * char_height, w, h };
+        SDL_RenderCopy(renderer, span.texture, nullptr, &dst);
     }
 }
 
 void SdlTerminal::render_cursor()
 {
-    if (cursor_visible) {
-        const auto &cursor = display.get_cursor();
-        if (cursor.row < get_rows() && cursor.col < get_cols()) {
+    if (scheduler.is_cursor_visible() && view_line < 0) {
+        Cursor cursor = display.get_cursor();
+        if (tmux && !tmux->get_cursor(cursor))
+            return;
+        if (!tmux && local_echo.is_visible() && !local_echo.get_predictions().empty()) {
+            // Cursor follows predicted echo.
+            const Prediction &last = local_echo.get_predictions().back();
+            cursor.row             = last.line - display.screen_line(0);
+            cursor.col             = last.col + 1;
+        }
+        if (cursor.row >= 0 && cursor.row < get_rows() && cursor.col < get_cols()) {
             SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
             SDL_Rect cursor_rect = { cursor.col * char_width, cursor.row * char_height, char_width,
                                      char_height };
@@ -363,6 +971,195 @@ void SdlTerminal::render_cursor()
     }
 }
 
+//
+// Draw predicted echo over the grid, underlined until it's confirmed.
+//
+void SdlTerminal::render_predictions()
+{
+    if (tmux || view_line >= 0 || !local_echo.is_visible())
+        return;
+
+    int64_t top  = display.screen_line(0);
+    SDL_Color fg = { 255, 255, 255, 255 };
+    for (const auto &p : local_echo.get_predictions()) {
+        int row = p.line - top;
+        if (row < 0 || row >= get_rows() || p.col >= get_cols())
+            continue;
+
+        SDL_Rect rect = { p.col * char_width, row * char_height, char_width, char_height };
+        SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
+        SDL_RenderFillRect(renderer, &rect);
+
+        std::string text     = wstring_to_utf8(std::wstring(1, p.ch));
+        SDL_Surface *surface = TTF_RenderUTF8_Blended(font, text.c_str(), fg);
+        if (surface) {
+            SDL_Texture *texture = SDL_CreateTextureFromSurface(renderer, surface);
+            if (texture) {
+                SDL_Rect dst = { rect.x, rect.y, surface->w, surface->h };
+                SDL_RenderCopy(renderer, texture, nullptr, &dst);
+                SDL_DestroyTexture(texture);
+            }
+            SDL_FreeSurface(surface);
+        }
+        SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
+        SDL_RenderDrawLine(renderer, rect.x, rect.y + char_height - 1, rect.x + char_width - 1,
+                           rect.y + char_height - 1);
+    }
+}
+
+//
+// Flash of visual bell: translucent overlay over the whole window.
+// Grid rows are not touched, so no textures are rebuilt.
+//
+void SdlTerminal::render_bell()
+{
+    if (!scheduler.is_bell_visible())
+        return;
+
+    SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
+    SDL_SetRenderDrawColor(renderer, 255, 255, 255, 96);
+    SDL_RenderFillRect(renderer, nullptr);
+    SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_NONE);
+}
+
+//
+// While scroll lock is on, show it in the top right corner.
+//
+void SdlTerminal::render_scroll_lock()
+{
+    if (!scroll_lock)
+        return;
+
+    SDL_Color fg         = { 0, 0, 0, 255 };
+    SDL_Surface *surface = TTF_RenderUTF8_Blended(font, " Scroll Lock ", fg);
+    if (!surface)
+        return;
+    SDL_Texture *texture = SDL_CreateTextureFromSurface(renderer, surface);
+    if (texture) {
+        SDL_Rect rect = { get_cols() * char_width - surface->w, 0, surface->w, surface->h };
+        SDL_SetRenderDrawColor(renderer, 255, 192, 0, 255);
+        SDL_RenderFillRect(renderer, &rect);
+        SDL_RenderCopy(renderer, texture, nullptr, &rect);
+        SDL_DestroyTexture(texture);
+    }
+    SDL_FreeSurface(surface);
+}
+
+//
+// Ring the bell, unless it rang recently.
+// Bells of one read are already coalesced by the terminal logic.
+//
+void SdlTerminal::ring_bell()
+{
+    if (!scheduler.ring_bell())
+        return;
+    need_present = true;
+    if (audio_device && SDL_GetQueuedAudioSize(audio_device) == 0) {
+        SDL_QueueAudio(audio_device, bell_sound.data(), bell_sound.size() * sizeof(int16_t));
+    }
+}
+
+//
+// Draw inline images over the grid. Textures are created on first use,
+// and shared by all placements of the same image.
+//
+void SdlTerminal::render_images()
+{
+    const auto &images = display.get_images();
+    int64_t top        = (view_line >= 0) ? view_line : display.screen_line(0);
+    for (const auto &placed : images) {
+        if (placed.line + placed.rows <= top || placed.line >= top + get_rows())
+            continue;
+
+        const InlineImage &image = *placed.image;
+        ImageTexture &entry      = image_textures[&image];
+        if (!entry.texture) {
+            entry.texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA32,
+                                              SDL_TEXTUREACCESS_STATIC, image.width, image.height);
+            if (!entry.texture) {
+                image_textures.erase(&image);
+                continue;
+            }
+            SDL_UpdateTexture(entry.texture, nullptr, image.pixels.data(), image.width * 4);
+            SDL_SetTextureBlendMode(entry.texture, SDL_BLENDMODE_BLEND);
+            entry.image = placed.image;
+            entry.bytes = image.pixels.size();
+            image_texture_bytes += entry.bytes;
+        }
+        SDL_Rect rect = { placed.col * char_width, int(placed.line - top) * char_height,
+                          placed.cols * char_width, placed.rows * char_height };
+        SDL_RenderCopy(renderer, entry.texture, nullptr, &rect);
+    }
+
+    // Forget textures of images dropped from history.
+    if (images.size() != placed_images) {
+        drop_image_textures(INT64_MIN, INT64_MAX);
+        placed_images = images.size();
+    }
+}
+
+//
+// Destroy textures of images not placed across given range of lines.
+// Return number of bytes released.
+//
+size_t SdlTerminal::drop_image_textures(int64_t first_line, int64_t last_line)
+{
+    std::unordered_set<const InlineImage *> kept;
+    for (const auto &placed : display.get_images()) {
+        if (placed.line + placed.rows > first_line && placed.line < last_line)
+            kept.insert(placed.image.get());
+    }
+    size_t released = 0;
+    for (auto it = image_textures.begin(); it != image_textures.end();) {
+        if (kept.count(it->first) && !it->second.image.expired()) {
+            ++it;
+            continue;
+        }
+        SDL_DestroyTexture(it->second.texture);
+        released += it->second.bytes;
+        it = image_textures.erase(it);
+    }
+    image_texture_bytes -= released;
+    return released;
+}
+
+//
+// Tint lines matched by output triggers.
+//
+void SdlTerminal::render_highlights()
+{
+    if (highlighted_lines.empty())
+        return;
+
+    int64_t top = (view_line >= 0) ? view_line : display.screen_line(0);
+    SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
+    SDL_SetRenderDrawColor(renderer, 255, 64, 64, 64);
+    for (int row = 0; row < get_rows(); ++row) {
+        if (is_highlighted(top + row)) {
+            SDL_Rect rect = { 0, row * char_height, get_cols() * char_width, char_height };
+            SDL_RenderFillRect(renderer, &rect);
+        }
+    }
+    SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_NONE);
+}
+
+//
+// Underline the link under mouse pointer.
+//
+void SdlTerminal::render_hover_link()
+{
+    if (!hover_link)
+        return;
+
+    SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
+    for (int row = hover_link->row; row <= hover_link->end_row; ++row) {
+        int first = (row == hover_link->row) ? hover_link->col : 0;
+        int last  = (row == hover_link->end_row) ? hover_link->end_col : get_cols() - 1;
+        int y     = (row + 1) * char_height - 1;
+        SDL_RenderDrawLine(renderer, first * char_width, y, (last + 1) * char_width - 1, y);
+    }
+}
+
 void SdlTerminal::handle_events()
 {
     SDL_Event event;
@@ -372,35 +1169,102 @@ void SdlTerminal::handle_events()
             kill(child_pid, SIGTERM);
             break;
         case SDL_KEYDOWN:
+            scheduler.key_pressed();
+            memory_trimmed = false;
             handle_key_event(event.key);
             break;
+        case SDL_MOUSEMOTION:
+            handle_mouse_motion(event.motion.x, event.motion.y);
+            break;
+        case SDL_MOUSEBUTTONDOWN:
+            // Ctrl+click opens the link.
+            if (event.button.button == SDL_BUTTON_LEFT && (SDL_GetModState() & KMOD_CTRL)) {
+                handle_mouse_motion(event.button.x, event.button.y);
+                if (hover_link) {
+                    open_link(hover_link->target);
+                }
+            }
+            break;
+        case SDL_RENDER_TARGETS_RESET:
+            // Contents of the grid layer are lost.
+            grid_stale.assign(get_rows(), true);
+            need_present = true;
+            break;
         case SDL_WINDOWEVENT:
+            // Window contents may be lost, repaint it.
+            need_present = true;
+            if (event.window.event == SDL_WINDOWEVENT_FOCUS_GAINED ||
+                event.window.event == SDL_WINDOWEVENT_FOCUS_LOST) {
+                bool focused = (event.window.event == SDL_WINDOWEVENT_FOCUS_GAINED);
+                MemoryGovernor::instance().set_focused(history_client, focused);
+                MemoryGovernor::instance().set_focused(glyph_client, focused);
+                MemoryGovernor::instance().set_focused(image_client, focused);
+            }
+            if (event.window.event == SDL_WINDOWEVENT_MINIMIZED ||
+                event.window.event == SDL_WINDOWEVENT_HIDDEN) {
+                window_hidden  = true;
+                memory_trimmed = false;
+                trim_memory();
+            } else if (event.window.event == SDL_WINDOWEVENT_RESTORED ||
+                       event.window.event == SDL_WINDOWEVENT_SHOWN ||
+                       event.window.event == SDL_WINDOWEVENT_EXPOSED) {
+                window_hidden  = false;
+                memory_trimmed = false;
+            }
             if (event.window.event == SDL_WINDOWEVENT_RESIZED) {
-                int new_cols = std::max(event.window.data1 / char_width, 1);
-                int new_rows = std::max(event.window.data2 / char_height, 1);
-                display.resize(new_cols, new_rows);
-                texture_cache.resize(new_rows);
-                dirty_lines.resize(new_rows, true);
-                dirty_lines.assign(new_rows, true);
-
-                struct winsize ws;
-                ws.ws_col    = get_cols();
-                ws.ws_row    = get_rows();
-                ws.ws_xpixel = get_cols() * char_width;
-                ws.ws_ypixel = get_rows() * char_height;
-                if (ioctl(master_fd, TIOCSWINSZ, &ws) == -1) {
-                    std::cerr << "Error setting slave window size: " << strerror(errno)
-                              << std::endl;
-                }
-                if (child_pid > 0) {
-                    kill(child_pid, SIGWINCH);
-                }
+                // Resize when the window size settles, not on every step of dragging.
+                scheduler.request_resize(std::max(event.window.data1 / char_width, 1),
+                                         std::max(event.window.data2 / char_height, 1));
             }
             break;
         }
     }
 }
 
+//
+// Resize the terminal, and tell the child about the new size.
+//
+void SdlTerminal::resize_terminal(int cols, int rows)
+{
+    int old_cols = get_cols();
+    display.resize(cols, rows);
+    if (get_cols() != old_cols) {
+        // Text was reflowed for the new width, so line numbers have moved.
+        for (auto &line : highlighted_lines) {
+            line = display.reflowed_line(line);
+        }
+        highlighted_lines.erase(std::unique(highlighted_lines.begin(), highlighted_lines.end()),
+                                highlighted_lines.end());
+        if (trigger_line_start >= 0) {
+            trigger_line_start = display.reflowed_line(trigger_line_start);
+        }
+        if (view_line >= 0) {
+            // History is shown: wait until it is reflowed.
+            display.finish_reflow();
+            view_line = std::max(display.reflowed_line(view_line), display.first_line());
+        }
+    }
+    clear_texture_cache();
+    texture_cache.resize(rows);
+    dirty_lines.assign(rows, true);
+    grid_stale.assign(rows, true);
+
+    struct winsize ws;
+    ws.ws_col    = get_cols();
+    ws.ws_row    = get_rows();
+    ws.ws_xpixel = get_cols() * char_width;
+    ws.ws_ypixel = get_rows() * char_height;
+    if (ioctl(master_fd, TIOCSWINSZ, &ws) == -1) {
+        std::cerr << "Error setting slave window size: " << strerror(errno) << std::endl;
+    }
+    if (tmux) {
+        send_to_child(TmuxControl::resize_client(get_cols(), get_rows()));
+    }
+    if (child_pid > 0) {
+        kill(child_pid, SIGWINCH);
+    }
+}
+
 void SdlTerminal::handle_key_event(const SDL_KeyboardEvent &key)
 {
     // Handle font size changes
@@ -425,18 +1289,30 @@ void SdlTerminal::handle_key_event(const SDL_KeyboardEvent &key)
         }
     }
 #endif
+    if (handle_scrollback_key(key.keysym)) {
+        return;
+    }
 
     // Forward key to terminal logic
     std::string input = display.process_key(keysym_to_key_input(key.keysym));
     if (!input.empty()) {
+        scroll_view(-1);
         // std::cerr << "Sending input: ";
         // for (char c : input) {
         //     std::cerr << (int)c << " ";
         // }
         // std::cerr << std::endl;
-        if (write(master_fd, input.c_str(), input.size()) < 0) {
-            std::cerr << "Error writing to slave: " << strerror(errno) << std::endl;
+        if (tmux) {
+            input = TmuxControl::send_keys(tmux->get_active_pane(), input);
+        } else if (input.size() == 1 && input[0] >= ' ' && input[0] < 0x7f &&
+                   !is_password_prompt()) {
+            if (local_echo.key_typed(input[0], display)) {
+                need_present = true;
+            }
+        } else {
+            local_echo.key_other();
         }
+        send_to_child(input);
     }
 }
 
@@ -562,6 +1438,179 @@ KeyInput SdlTerminal::keysym_to_key_input(const SDL_Keysym &keysym)
     return key;
 }
 
+//
+// Keys for scrollback and shell integration:
+//  Shift+PageUp/PageDown  - scroll by page
+//  Ctrl+Shift+Up/Down     - jump to previous/next prompt
+//  Ctrl+Shift+O           - copy output of the last command to clipboard
+//
+bool SdlTerminal::handle_scrollback_key(const SDL_Keysym &keysym)
+{
+    if (keysym.sym == SDLK_SCROLLLOCK) {
+        scroll_lock  = !scroll_lock;
+        need_present = true;
+        return true;
+    }
+    if (!(keysym.mod & KMOD_SHIFT))
+        return false;
+
+    int64_t live_top = display.screen_line(0);
+    int64_t top      = (view_line >= 0) ? view_line : live_top;
+    if (keysym.mod & KMOD_CTRL) {
+        int64_t prompt;
+        switch (keysym.sym) {
+        case SDLK_UP:
+            prompt = display.find_prompt(top, false);
+            if (prompt >= 0) {
+                scroll_view(prompt);
+            }
+            return true;
+        case SDLK_DOWN:
+            prompt = display.find_prompt(top, true);
+            scroll_view(prompt >= 0 ? prompt : -1);
+            return true;
+        case SDLK_o:
+            SDL_SetClipboardText(display.last_command_output().c_str());
+            return true;
+        case SDLK_s:
+            scroll_lock  = !scroll_lock;
+            need_present = true;
+            return true;
+        default:
+            return false;
+        }
+    }
+    switch (keysym.sym) {
+    case SDLK_PAGEUP:
+        scroll_view(std::max(top - get_rows(), display.first_line()));
+        return true;
+    case SDLK_PAGEDOWN:
+        scroll_view(top + get_rows());
+        return true;
+    default:
+        return false;
+    }
+}
+
+//
+// Show lines starting from given absolute line number.
+// Below the live screen, or with -1, return to the live screen.
+//
+void SdlTerminal::scroll_view(int64_t top_line)
+{
+    if (top_line >= display.screen_line(0)) {
+        top_line = -1;
+    } else if (top_line >= 0) {
+        // History is shown: wait until it is reflowed.
+        display.finish_reflow();
+        top_line = std::max(top_line, display.first_line());
+    }
+    if (top_line == view_line)
+        return;
+
+    view_line = top_line;
+    dirty_lines.assign(get_rows(), true);
+    need_present = true;
+}
+
+void SdlTerminal::handle_mouse_motion(int x, int y)
+{
+    if (char_width == 0 || char_height == 0)
+        return;
+
+    mouse_row = y / char_height;
+    mouse_col = x / char_width;
+    update_hover_link();
+}
+
+//
+// Find link under mouse pointer, using cached results of the link detector.
+//
+void SdlTerminal::update_hover_link()
+{
+    const Link *link = (view_line < 0 && !tmux) ? links.find(mouse_row, mouse_col) : nullptr;
+    if (link == hover_link)
+        return;
+
+    if (!hand_cursor) {
+        hand_cursor  = SDL_CreateSystemCursor(SDL_SYSTEM_CURSOR_HAND);
+        arrow_cursor = SDL_CreateSystemCursor(SDL_SYSTEM_CURSOR_ARROW);
+    }
+    SDL_SetCursor(link ? hand_cursor : arrow_cursor);
+    hover_link   = link;
+    need_present = true;
+}
+
+//
+// Open URL or file in external application.
+// Double fork, so that no zombie is left behind.
+//
+void SdlTerminal::open_link(const std::string &target)
+{
+#ifdef __APPLE__
+    const char *opener = "open";
+#else
+    const char *opener = "xdg-open";
+#endif
+    pid_t pid = fork();
+    if (pid == 0) {
+        if (fork() == 0) {
+            execlp(opener, opener, target.c_str(), nullptr);
+            _exit(127);
+        }
+        _exit(0);
+    }
+    if (pid > 0) {
+        int status;
+        waitpid(pid, &status, 0);
+    }
+}
+
+//
+// Called for every row completed by the terminal logic, so every byte
+// of output is matched once. Matching state continues over wrapped rows.
+//
+void SdlTerminal::check_triggers(int64_t line, const Line &text, bool wrap)
+{
+    if (trigger_line_start < 0) {
+        trigger_line_start = line;
+    }
+    int pattern = triggers.feed(text);
+    if (pattern >= 0 && !trigger_matched) {
+        trigger_matched = true;
+        if (verbose) {
+            std::cerr << "Trigger: " << triggers.get_pattern(pattern) << std::endl;
+        }
+#if SDL_VERSION_ATLEAST(2, 0, 16)
+        SDL_FlashWindow(window, SDL_FLASH_BRIEFLY);
+#endif
+    }
+    if (trigger_matched) {
+        // Forget lines dropped from history.
+        auto first = std::lower_bound(highlighted_lines.begin(), highlighted_lines.end(),
+                                      display.first_line());
+        highlighted_lines.erase(highlighted_lines.begin(), first);
+
+        for (int64_t n = std::max(trigger_line_start, display.first_line()); n <= line; ++n) {
+            if (!is_highlighted(n)) {
+                highlighted_lines.insert(
+                    std::upper_bound(highlighted_lines.begin(), highlighted_lines.end(), n), n);
+            }
+        }
+        need_present = true;
+    }
+    if (!wrap) {
+        triggers.reset();
+        trigger_line_start = -1;
+        trigger_matched    = false;
+    }
+}
+
+bool SdlTerminal::is_highlighted(int64_t line) const
+{
+    return std::binary_search(highlighted_lines.begin(), highlighted_lines.end(), line);
+}
+
 void SdlTerminal::change_font_size(int delta)
 {
     int new_size = font_size + delta;
@@ -595,6 +1644,7 @@ void SdlTerminal::change_font_size(int delta)
         font = nullptr;
         return;
     }
+    display.set_cell_size(char_width, char_height);
 
     SDL_SetWindowSize(window, get_cols() * char_width, get_rows() * char_height);
 
@@ -603,31 +1653,7 @@ void SdlTerminal::change_font_size(int delta)
     int new_cols = std::max(win_width / char_width, 1);
     int new_rows = std::max(win_height / char_height, 1);
 
-    struct winsize ws;
-    ws.ws_col    = new_cols;
-    ws.ws_row    = new_rows;
-    ws.ws_xpixel = new_cols * char_width;
-    ws.ws_ypixel = new_rows * char_height;
-    if (ioctl(master_fd, TIOCSWINSZ, &ws) == -1) {
-        std::cerr << "Error setting slave window size: " << strerror(errno) << std::endl;
-    } else {
-        // std::cerr << "Updated slave size to " << ws.ws_col << "x" << ws.ws_row << std::endl;
-    }
-
-    if (child_pid > 0) {
-        kill(child_pid, SIGWINCH);
-    }
-
-    display.resize(new_cols, new_rows);
-    for (auto &line_spans : texture_cache) {
-        for (auto &span : line_spans) {
-            if (span.texture)
-                SDL_DestroyTexture(span.texture);
-        }
-    }
-    texture_cache.resize(new_rows);
-    dirty_lines.resize(new_rows, true);
-    dirty_lines.assign(new_rows, true);
+    resize_terminal(new_cols, new_rows);
 
     // std::cerr << "Changed font size to " << font_size << ", terminal size to " << get_cols() <<
     // "x"
@@ -636,6 +1662,13 @@ void SdlTerminal::change_font_size(int delta)
 
 void SdlTerminal::process_pty_input()
 {
+    if (is_output_paused()) {
+        // Output stays in the kernel buffer: wait as usual, but don't read.
+        struct timeval tv = { 0, 10000 };
+        select(0, nullptr, nullptr, nullptr, &tv);
+        return;
+    }
+
     fd_set read_fds;
     FD_ZERO(&read_fds);
     FD_SET(master_fd, &read_fds);
@@ -644,32 +1677,148 @@ void SdlTerminal::process_pty_input()
     if (select(master_fd + 1, &read_fds, nullptr, nullptr, &tv) <= 0)
         return;
 
-    if (FD_ISSET(master_fd, &read_fds)) {
-        char buffer[1024];
-        ssize_t bytes = read(master_fd, buffer, sizeof(buffer) - 1);
-        if (bytes <= 0) {
-            if (bytes < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
-                std::cerr << "Error reading from master_fd: " << strerror(errno) << std::endl;
-                kill(child_pid, SIGTERM);
-            }
-            return;
+    if (!FD_ISSET(master_fd, &read_fds))
+        return;
+
+    // Keep reading until the child has nothing more to say,
+    // or until the time slice is over and a frame is due.
+    scheduler.start_slice();
+    while (read_pty() && !scheduler.slice_expired()) {
+        continue;
+    }
+}
+
+//
+// Read available output of the child, without waiting, and process it.
+// Return false when there is nothing to read.
+//
+bool SdlTerminal::read_pty()
+{
+    if (is_output_paused())
+        return false;
+
+    char buffer[1024];
+    ssize_t bytes = read(master_fd, buffer, sizeof(buffer) - 1);
+    if (bytes <= 0) {
+        if (bytes < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+            std::cerr << "Error reading from master_fd: " << strerror(errno) << std::endl;
+            kill(child_pid, SIGTERM);
         }
+        return false;
+    }
 
-        buffer[bytes] = '\0';
-        // std::cerr << "Read " << bytes << " bytes: ";
-        // for (ssize_t j = 0; j < bytes; ++j) {
-        //     std::cerr << (int)buffer[j] << " ";
-        // }
-        // std::cerr << std::endl;
+    buffer[bytes] = '\0';
+    bytes_received += bytes;
+    if (output_delay > 0) {
+        // Slow link: output is held for a while.
+        delayed_output.push(buffer, bytes, clock.now_ms() + output_delay);
+        return true;
+    }
+    handle_output(buffer, bytes);
+    return true;
+}
 
-        // Process input through terminal logic
-        auto dirty_rows = display.process_input(buffer, bytes);
-        for (int row : dirty_rows) {
-            if (row >= 0 && static_cast<size_t>(row) < dirty_lines.size()) {
-                dirty_lines[row] = true;
-            }
+//
+// Process output of the child through terminal logic.
+//
+void SdlTerminal::handle_output(const char *data, size_t length)
+{
+    scheduler.activity();
+    memory_trimmed  = false;
+    auto dirty_rows = process_output(data, length);
+    send_to_child(display.take_responses());
+    for (const auto &scroll : display.take_scrolls()) {
+        if (!tmux && view_line < 0) {
+            scroll_rows(scroll);
+        }
+    }
+    if (display.take_bell()) {
+        ring_bell();
+    }
+    if (view_line >= 0) {
+        // Scrolled back: lines may have been dropped from history.
+        view_line = std::max(view_line, display.first_line());
+        dirty_lines.assign(get_rows(), true);
+    }
+    for (int row : dirty_rows) {
+        if (row >= 0 && static_cast<size_t>(row) < dirty_lines.size()) {
+            dirty_lines[row] = true;
         }
     }
+    if (local_echo.validate(display)) {
+        need_present = true;
+    }
+    MemoryGovernor::instance().touch(history_client);
+    MemoryGovernor::instance().enforce();
+}
+
+//
+// Canonical mode without echo: the child asks for a password,
+// so typed characters must not be shown.
+// Master and slave sides of the pseudo-terminal share their settings.
+//
+bool SdlTerminal::is_password_prompt() const
+{
+    struct termios tio;
+    if (tcgetattr(master_fd, &tio) == -1)
+        return false;
+    return (tio.c_lflag & ICANON) && !(tio.c_lflag & ECHO);
+}
+
+//
+// Pass output of the child to terminal logic, or to tmux control client
+// between start and end of control mode.
+// Return rows to redraw.
+//
+std::vector<int> SdlTerminal::process_output(const char *data, size_t length)
+{
+    std::vector<int> dirty_rows;
+    std::string joined;
+    if (!tmux) {
+        // Start sequence can be split between reads: the end of output which
+        // may begin it is held back, and goes before the next output.
+        if (!tmux_start_tail.empty()) {
+            joined = tmux_start_tail;
+            joined.append(data, length);
+            tmux_start_tail.clear();
+            data   = joined.data();
+            length = joined.size();
+        }
+        std::string_view text(data, length);
+        size_t start = text.find(TmuxControl::start_sequence);
+        if (start == std::string_view::npos) {
+            size_t keep = TmuxControl::start_prefix_length(text);
+            tmux_start_tail.assign(data + length - keep, keep);
+            return display.process_input(data, length - keep);
+        }
+
+        dirty_rows = display.process_input(data, start);
+        data += start + TmuxControl::start_sequence.size();
+        length -= start + TmuxControl::start_sequence.size();
+        tmux = std::make_unique<TmuxControl>();
+        send_to_child(TmuxControl::resize_client(get_cols(), get_rows()));
+        scroll_view(-1);
+        dirty_lines.assign(get_rows(), true);
+    }
+
+    size_t consumed = tmux->process_input(data, length, dirty_rows);
+    if (tmux->is_active())
+        return dirty_rows;
+
+    // Control mode finished: back to the terminal screen.
+    tmux.reset();
+    dirty_lines.assign(get_rows(), true);
+    for (int row : display.process_input(data + consumed, length - consumed)) {
+        dirty_rows.push_back(row);
+    }
+    return dirty_rows;
+}
+
+void SdlTerminal::send_to_child(const std::string &data)
+{
+    if (!data.empty() && write(master_fd, data.c_str(), data.size()) < 0) {
+        std::cerr << "Error writing to slave: " << strerror(errno) << std::endl;
+    }
 }
 
 void SdlTerminal::forward_signal(int sig)
@@ -679,37 +1828,10 @@ void SdlTerminal::forward_signal(int sig)
     }
 }
 
+//
+// Only async-signal-safe work here: the resize itself is done by the main loop.
+//
 void SdlTerminal::handle_sigwinch(int sig)
 {
-    if (terminal_instance) {
-        int win_width, win_height;
-        SDL_GetWindowSize(terminal_instance->window, &win_width, &win_height);
-        int new_cols = std::max(win_width / terminal_instance->char_width, 1);
-        int new_rows = std::max(win_height / terminal_instance->char_height, 1);
-
-        struct winsize ws;
-        ws.ws_col    = new_cols;
-        ws.ws_row    = new_rows;
-        ws.ws_xpixel = new_cols * terminal_instance->char_width;
-        ws.ws_ypixel = new_rows * terminal_instance->char_height;
-        if (ioctl(terminal_instance->master_fd, TIOCSWINSZ, &ws) == -1) {
-            std::cerr << "Error setting slave window size: " << strerror(errno) << std::endl;
-            return;
-        }
-
-        terminal_instance->display.resize(new_cols, new_rows);
-        for (auto &line_spans : terminal_instance->texture_cache) {
-            for (auto &span : line_spans) {
-                if (span.texture)
-                    SDL_DestroyTexture(span.texture);
-            }
-        }
-        terminal_instance->texture_cache.resize(new_rows);
-        terminal_instance->dirty_lines.resize(new_rows, true);
-        terminal_instance->dirty_lines.assign(new_rows, true);
-
-        if (terminal_instance->child_pid > 0) {
-            kill(terminal_instance->child_pid, SIGWINCH);
-        }
-    }
+    window_size_changed = 1;
 }
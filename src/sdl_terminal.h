@@ -27,10 +27,20 @@
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_ttf.h>
 
+#include <memory>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include "ansi_logic.h"
+#include "clock.h"
+#include "frame_scheduler.h"
+#include "link_detector.h"
+#include "local_echo.h"
+#include "output_queue.h"
+#include "perf_counters.h"
+#include "tmux_control.h"
+#include "trigger_engine.h"
 
 #ifdef __linux__
 #include <pty.h>
@@ -46,16 +56,40 @@ struct TextSpan {
     SDL_Texture *texture = nullptr;
 };
 
+// Part of benchmark output
+struct BenchWorkload {
+    std::string name;
+    std::string output;
+};
+
 class SdlTerminal {
 public:
-    SdlTerminal(int cols, int rows);
+    SdlTerminal(int cols, int rows, Clock &clock = Clock::system());
     ~SdlTerminal();
+    void set_verbose(bool on) { verbose = on; }
+    void add_trigger(const std::string &pattern) { triggers.add_pattern(pattern); }
+    void set_audible_bell(bool on) { audible_bell = on; }
+    void set_local_echo(LocalEcho::Mode mode) { local_echo.set_mode(mode); }
+    void set_output_delay(unsigned msec) { output_delay = msec; }
     bool initialize();
     void run();
+    bool run_idle_test(unsigned seconds);
+
+    // Benchmark: the child writes given output instead of running a shell.
+    // With hardware counters, they are measured around every frame.
+    void set_bench(std::vector<BenchWorkload> workloads) { bench_workloads = std::move(workloads); }
+    void set_bench_perf(bool on) { bench_perf = on; }
+    bool run_bench();
+    static const char *default_font_path();
 
 private:
+    // Timing of frames, blink, bell and idle state
+    Clock &clock;
+    FrameScheduler scheduler;
+
     // Terminal state
     std::vector<std::vector<TextSpan>> texture_cache;
+    size_t texture_bytes{}; // Memory used by textures in cache
     std::vector<bool> dirty_lines;
     int font_size{ 16 }; // Current font size in points
     std::string font_path;
@@ -66,16 +100,92 @@ private:
     TTF_Font *font{};
     int char_width{};
     int char_height{};
-    bool cursor_visible{ true };
-    Uint32 last_cursor_toggle{};
-    static const Uint32 cursor_blink_interval = 500;
+    bool need_present{ true }; // Frame must be presented even when no lines are dirty
+
+    // Frame is composed of layers: grid of text, then overlays, then cursor.
+    // Grid is a render target, where only changed rows are redrawn.
+    SDL_Texture *grid_texture{};
+    std::vector<bool> grid_stale; // Rows to redraw into the grid
+
+    // Rows scrolled by the terminal logic are moved in the grid by texture copy,
+    // through a scratch texture, on the next frame.
+    SDL_Texture *grid_scratch{};
+    std::vector<ScrollDamage> grid_scrolls;
+
+    // Textures of inline images, shared by all placements of an image.
+    // Image is watched, so that its address is not reused while the texture is kept.
+    struct ImageTexture {
+        std::weak_ptr<const InlineImage> image;
+        SDL_Texture *texture;
+        size_t bytes;
+    };
+    std::unordered_map<const InlineImage *, ImageTexture> image_textures;
+    size_t image_texture_bytes{};
+    size_t placed_images{}; // Number of placements when textures were last checked
+
+    // Bell: flash overlay and optional sound, at most one per cooldown period
+    bool audible_bell{};
+    SDL_AudioDeviceID audio_device{};
+    std::vector<int16_t> bell_sound;
+
+    // Main loop statistics
+    uint64_t loop_iterations{};
+    uint64_t frames_presented{};
+    uint64_t frames_skipped{}; // Changes deferred to a later frame
+    uint64_t bytes_received{}; // Output of the child
+    bool verbose{}; // Report memory trims
+
+    // Idle state
+    bool window_hidden{};  // Minimized or hidden: nothing to render
+    bool memory_trimmed{}; // Caches already released in this idle period
+
+    // Scrollback view: absolute line at the top of the window, or -1 for live screen
+    int64_t view_line{ -1 };
+
+    // Links on the screen, and the one under mouse pointer
+    LinkDetector links;
+    int mouse_row{ -1 };
+    int mouse_col{ -1 };
+    const Link *hover_link{};
+    SDL_Cursor *hand_cursor{};
+    SDL_Cursor *arrow_cursor{};
+
+    // Output triggers: lines matching any pattern are highlighted
+    TriggerEngine triggers;
+    int64_t trigger_line_start{ -1 };       // First row of current logical line
+    bool trigger_matched{};                 // Current logical line already matched
+    std::vector<int64_t> highlighted_lines; // Sorted absolute line numbers
+
+    // Typed characters are drawn before their echo arrives
+    LocalEcho local_echo{ clock };
+
+    // Clients of memory governor
+    int history_client{};
+    int glyph_client{};
+    int image_client{};
 
     // PTY and child process
     int master_fd{ -1 };
     pid_t child_pid{};
+    std::vector<BenchWorkload> bench_workloads; // Output of generator child
+    bool bench_perf{};                          // Report hardware counters
+
+    // Hardware counters, summed over rendered frames
+    PerfCounters perf;
+    uint64_t frame_events[PerfCounters::NUM_EVENTS]{};
+
+    // Flow control: output is not read while the display is frozen by scroll lock,
+    // or while too much of it waits to be parsed. Then the child blocks on write.
+    static const size_t max_backlog = 1 << 20;  // Bytes
+    unsigned output_delay{};                    // Simulate slow link, msec
+    OutputQueue delayed_output{ max_backlog };  // Read, but not parsed yet
+    bool scroll_lock{};                         // Display frozen by user
+    bool is_output_paused() const { return scroll_lock || delayed_output.is_full(); }
 
     // Terminal logic
     AnsiLogic display;
+    std::unique_ptr<TmuxControl> tmux; // In tmux control mode: panes replace the display
+    std::string tmux_start_tail;       // End of output which may begin the start sequence
     int get_cols() const { return display.get_cols(); }
     int get_rows() const { return display.get_rows(); }
 
@@ -83,21 +193,56 @@ private:
     bool initialize_sdl();
     bool initialize_pty(struct termios &slave_termios, char *&slave_name);
     bool initialize_child_process(const char *slave_name, const struct termios &slave_termios);
+    [[noreturn]] void run_generator() const;
+
+    // Main loop
+    bool run_once();
+    void resize_terminal(int cols, int rows);
 
     // Rendering methods
     void render_text();
     void update_texture_cache();
-    void render_spans();
+    void clear_texture_cache();
+    void add_span(int row, const std::wstring &text, const CharAttr &attr, int start_col);
+    void destroy_line_textures(int row);
+    void trim_memory();
+    void render_grid();
+    void scroll_rows(const ScrollDamage &scroll);
+    void scroll_grid(const ScrollDamage &scroll);
+    void render_row(int row);
     void render_cursor();
+    void render_predictions();
+    void render_hover_link();
+    void render_images();
+    size_t drop_image_textures(int64_t first_line, int64_t last_line);
+    void render_highlights();
+    void render_bell();
+    void render_scroll_lock();
+    void ring_bell();
+    void initialize_audio();
 
     // Input handling methods
     void handle_events();
     void handle_key_event(const SDL_KeyboardEvent &key);
     void change_font_size(int delta);
+    void scroll_view(int64_t top_line);
+    bool handle_scrollback_key(const SDL_Keysym &keysym);
+    void handle_mouse_motion(int x, int y);
+    void update_hover_link();
+    static void open_link(const std::string &target);
+
+    // Output triggers
+    void check_triggers(int64_t line, const Line &text, bool wrap);
+    bool is_highlighted(int64_t line) const;
     static KeyInput keysym_to_key_input(const SDL_Keysym &keysym);
 
     // PTY input handling
     void process_pty_input();
+    bool read_pty();
+    void handle_output(const char *data, size_t length);
+    bool is_password_prompt() const;
+    std::vector<int> process_output(const char *data, size_t length);
+    void send_to_child(const std::string &data);
 
     // Signal handlers
     static void forward_signal(int sig);
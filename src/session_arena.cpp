@@ -0,0 +1,82 @@
+//
+// Per-session memory arena.
+//
+// Copyright (c) 2025 Serge Vakulenko
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include "session_arena.h"
+
+#include <algorithm>
+
+SessionArena::SessionArena()
+    : pool(std::make_unique<std::pmr::unsynchronized_pool_resource>(&system))
+{
+}
+
+SessionArena::~SessionArena()
+{
+    // Destroying the pool returns all chunks to the system at once.
+    pool.reset();
+}
+
+void SessionArena::reset()
+{
+    pool = std::make_unique<std::pmr::unsynchronized_pool_resource>(&system);
+    in_use = 0;
+}
+
+void *SessionArena::do_allocate(size_t bytes, size_t alignment)
+{
+    std::lock_guard<std::mutex> lock(pool_mutex);
+    void *p = pool->allocate(bytes, alignment);
+    in_use += bytes;
+    return p;
+}
+
+void SessionArena::do_deallocate(void *p, size_t bytes, size_t alignment)
+{
+    std::lock_guard<std::mutex> lock(pool_mutex);
+    pool->deallocate(p, bytes, alignment);
+    in_use -= bytes;
+}
+
+bool SessionArena::do_is_equal(const std::pmr::memory_resource &other) const noexcept
+{
+    return this == &other;
+}
+
+void *SessionArena::SystemMemory::do_allocate(size_t bytes, size_t alignment)
+{
+    void *p = std::pmr::new_delete_resource()->allocate(bytes, alignment);
+    reserved += bytes;
+    peak = std::max(peak.load(), reserved.load());
+    return p;
+}
+
+void SessionArena::SystemMemory::do_deallocate(void *p, size_t bytes, size_t alignment)
+{
+    std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+    reserved -= bytes;
+}
+
+bool SessionArena::SystemMemory::do_is_equal(const std::pmr::memory_resource &other) const noexcept
+{
+    return this == &other;
+}
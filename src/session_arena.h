@@ -0,0 +1,85 @@
+//
+// Per-session memory arena.
+//
+// Copyright (c) 2025 Serge Vakulenko
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef SESSION_ARENA_H
+#define SESSION_ARENA_H
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+
+//
+// Memory resource for all data of one terminal session.
+// Allocations are served by a pool, which gets memory from the system
+// in large chunks, and gives it all back at once when the session is closed.
+// Both live data and memory taken from the system are counted exactly.
+// Worker threads may allocate too, for example to reflow history.
+//
+class SessionArena : public std::pmr::memory_resource {
+public:
+    SessionArena();
+    ~SessionArena();
+    SessionArena(const SessionArena &) = delete;
+    SessionArena &operator=(const SessionArena &) = delete;
+
+    // Bytes allocated by the session and not yet freed.
+    size_t bytes_in_use() const { return in_use; }
+
+    // Bytes taken from the system, including free pool blocks.
+    size_t bytes_reserved() const { return system.reserved; }
+
+    // Highest value of bytes_reserved() so far.
+    size_t peak_bytes_reserved() const { return system.peak; }
+
+    // Return all memory to the system and start over.
+    // Everything allocated from the arena must be freed before that.
+    void reset();
+
+private:
+    //
+    // Upstream resource, which counts memory taken from the system.
+    //
+    class SystemMemory : public std::pmr::memory_resource {
+    public:
+        std::atomic<size_t> reserved{};
+        std::atomic<size_t> peak{};
+
+    private:
+        void *do_allocate(size_t bytes, size_t alignment) override;
+        void do_deallocate(void *p, size_t bytes, size_t alignment) override;
+        bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override;
+    };
+
+    SystemMemory system;
+    std::unique_ptr<std::pmr::unsynchronized_pool_resource> pool;
+    std::mutex pool_mutex;
+    std::atomic<size_t> in_use{};
+
+    void *do_allocate(size_t bytes, size_t alignment) override;
+    void do_deallocate(void *p, size_t bytes, size_t alignment) override;
+    bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override;
+};
+
+#endif // SESSION_ARENA_H
@@ -0,0 +1,375 @@
+//
+// Vectorized scanning kernels with run-time CPU dispatch.
+//
+// Copyright (c) 2025 Serge Vakulenko
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include "simd_scan.h"
+
+#include <algorithm>
+#include <iterator>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define SIMD_X86 1
+#include <immintrin.h>
+#elif defined(__aarch64__)
+#define SIMD_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace simd {
+
+namespace {
+
+//
+// Set of kernels for one instruction set.
+//
+struct Kernels {
+    const char *name;
+    size_t (*scan_printable)(const char *buf, size_t len);
+    size_t (*decode_base64)(const char *text, size_t len, uint8_t *out);
+};
+
+//
+// Scalar reference implementation.
+// Vector variants use it for the tail of the buffer.
+//
+size_t scan_printable_scalar(const char *buf, size_t len)
+{
+    size_t i = 0;
+    while (i < len && buf[i] >= 0x20 && buf[i] < 0x7f) {
+        ++i;
+    }
+    return i;
+}
+
+//
+// Values of base64 characters, -1 for others.
+//
+struct Base64Table {
+    int8_t value[256];
+
+    Base64Table()
+    {
+        static const char alphabet[] =
+            "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+        std::fill(std::begin(value), std::end(value), -1);
+        for (int i = 0; i < 64; ++i) {
+            value[static_cast<uint8_t>(alphabet[i])] = i;
+        }
+    }
+};
+
+const Base64Table base64_table;
+
+size_t decode_base64_scalar(const char *text, size_t len, uint8_t *out)
+{
+    const int8_t *value = base64_table.value;
+    size_t i            = 0;
+    for (; i + 4 <= len; i += 4) {
+        int a = value[static_cast<uint8_t>(text[i])];
+        int b = value[static_cast<uint8_t>(text[i + 1])];
+        int c = value[static_cast<uint8_t>(text[i + 2])];
+        int d = value[static_cast<uint8_t>(text[i + 3])];
+        if ((a | b | c | d) < 0) {
+            break;
+        }
+        uint32_t v = (a << 18) | (b << 12) | (c << 6) | d;
+        *out++     = v >> 16;
+        *out++     = v >> 8;
+        *out++     = v;
+    }
+    return i;
+}
+
+const Kernels scalar_kernels = { "scalar", scan_printable_scalar, decode_base64_scalar };
+
+#ifdef SIMD_X86
+//
+// SSE2: 16 bytes per step. Bytes are compared as signed,
+// so everything above 0x7f is negative and fails the lower bound.
+//
+__attribute__((target("sse2"))) size_t scan_printable_sse2(const char *buf, size_t len)
+{
+    const __m128i lo = _mm_set1_epi8(0x1f);
+    const __m128i hi = _mm_set1_epi8(0x7f);
+    size_t i         = 0;
+    for (; i + 16 <= len; i += 16) {
+        __m128i v  = _mm_loadu_si128(reinterpret_cast<const __m128i *>(buf + i));
+        __m128i ok = _mm_and_si128(_mm_cmpgt_epi8(v, lo), _mm_cmplt_epi8(v, hi));
+        unsigned m = ~_mm_movemask_epi8(ok) & 0xffff;
+        if (m != 0) {
+            return i + __builtin_ctz(m);
+        }
+    }
+    return i + scan_printable_scalar(buf + i, len - i);
+}
+
+//
+// Mask of bytes in range first...last: the range is moved to the bottom
+// of signed bytes, so one compare does.
+//
+__attribute__((target("sse2"))) __m128i in_range_sse2(__m128i v, char first, char last)
+{
+    __m128i moved = _mm_add_epi8(v, _mm_set1_epi8(static_cast<char>(0x80 - first)));
+    return _mm_cmplt_epi8(moved, _mm_set1_epi8(static_cast<char>(0x80 + last - first + 1)));
+}
+
+//
+// SSE2 base64: 16 characters per step. Without pshufb, characters are classified
+// by range compares, and each range adds its own offset. 6-bit values are packed
+// by shifts and multiply-add, then 12 bytes are stored out of 16.
+//
+__attribute__((target("sse2"))) size_t decode_base64_sse2(const char *text, size_t len,
+                                                          uint8_t *out)
+{
+    const __m128i low_byte = _mm_set1_epi16(0x00ff);
+    const __m128i mid_byte = _mm_set1_epi32(0x0000ff00);
+    const __m128i top_byte = _mm_set1_epi32(0x00ff0000);
+    const __m128i low_half = _mm_set1_epi64x(0x000000ffffff);
+    const __m128i top_half = _mm_set1_epi64x(0xffffff000000);
+    size_t i               = 0;
+    for (; i + 24 <= len; i += 16) {
+        __m128i v     = _mm_loadu_si128(reinterpret_cast<const __m128i *>(text + i));
+        __m128i upper = in_range_sse2(v, 'A', 'Z');
+        __m128i lower = in_range_sse2(v, 'a', 'z');
+        __m128i digit = in_range_sse2(v, '0', '9');
+        __m128i plus  = _mm_cmpeq_epi8(v, _mm_set1_epi8('+'));
+        __m128i slash = _mm_cmpeq_epi8(v, _mm_set1_epi8('/'));
+        __m128i valid = _mm_or_si128(_mm_or_si128(upper, lower),
+                                     _mm_or_si128(digit, _mm_or_si128(plus, slash)));
+        if (_mm_movemask_epi8(valid) != 0xffff) {
+            break;
+        }
+        __m128i shift = _mm_or_si128(
+            _mm_or_si128(_mm_and_si128(upper, _mm_set1_epi8(-'A')),
+                         _mm_and_si128(lower, _mm_set1_epi8(26 - 'a'))),
+            _mm_or_si128(_mm_and_si128(digit, _mm_set1_epi8(52 - '0')),
+                         _mm_or_si128(_mm_and_si128(plus, _mm_set1_epi8(62 - '+')),
+                                      _mm_and_si128(slash, _mm_set1_epi8(63 - '/')))));
+        v = _mm_add_epi8(v, shift);
+
+        // Pairs of characters into 12 bits, then pairs of those into 24 bits.
+        v = _mm_or_si128(_mm_slli_epi16(_mm_and_si128(v, low_byte), 6), _mm_srli_epi16(v, 8));
+        v = _mm_madd_epi16(v, _mm_set1_epi32(0x00011000));
+
+        // Big-endian order of bytes in every 32-bit lane, then drop the fourth bytes.
+        v = _mm_or_si128(_mm_or_si128(_mm_srli_epi32(v, 16), _mm_and_si128(v, mid_byte)),
+                         _mm_and_si128(_mm_slli_epi32(v, 16), top_byte));
+        v = _mm_or_si128(_mm_and_si128(v, low_half),
+                         _mm_and_si128(_mm_srli_epi64(v, 8), top_half));
+        v = _mm_or_si128(_mm_and_si128(v, _mm_set_epi64x(0, 0xffffffffffff)),
+                         _mm_slli_si128(_mm_srli_si128(v, 8), 6));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out), v);
+        out += 12;
+    }
+    return i + decode_base64_scalar(text + i, len - i, out);
+}
+
+const Kernels sse2_kernels = { "sse2", scan_printable_sse2, decode_base64_sse2 };
+
+//
+// AVX2: 32 bytes per step.
+//
+__attribute__((target("avx2"))) size_t scan_printable_avx2(const char *buf, size_t len)
+{
+    const __m256i lo = _mm256_set1_epi8(0x1f);
+    const __m256i hi = _mm256_set1_epi8(0x7f);
+    size_t i         = 0;
+    for (; i + 32 <= len; i += 32) {
+        __m256i v  = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(buf + i));
+        __m256i ok = _mm256_and_si256(_mm256_cmpgt_epi8(v, lo), _mm256_cmpgt_epi8(hi, v));
+        unsigned m = ~static_cast<unsigned>(_mm256_movemask_epi8(ok));
+        if (m != 0) {
+            return i + __builtin_ctz(m);
+        }
+    }
+    return i + scan_printable_sse2(buf + i, len - i);
+}
+
+//
+// AVX2 base64: 32 characters per step (Mula and Lemire). Characters are classified
+// by lookup of both nibbles, and converted by adding an offset chosen by the high nibble.
+// Then 6-bit values are packed by multiply-add, and 24 bytes are stored out of 32:
+// the loop stops early enough to have room for the rest.
+//
+__attribute__((target("avx2"))) size_t decode_base64_avx2(const char *text, size_t len,
+                                                          uint8_t *out)
+{
+    const __m256i lut_lo   = _mm256_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+                                              0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a,
+                                              0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+                                              0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a);
+    const __m256i lut_hi   = _mm256_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+                                              0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+                                              0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+                                              0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+    const __m256i lut_roll = _mm256_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0,
+                                              0, 0, 0, 0, 16, 19, 4, -65, -65, -71, -71, 0, 0,
+                                              0, 0, 0, 0, 0, 0);
+    const __m256i pack     = _mm256_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1,
+                                              -1, 2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1,
+                                              -1, -1);
+    const __m256i slash    = _mm256_set1_epi8(0x2f);
+    size_t i               = 0;
+    for (; i + 44 <= len; i += 32) {
+        __m256i v  = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(text + i));
+        __m256i hn = _mm256_and_si256(_mm256_srli_epi32(v, 4), slash);
+        __m256i ln = _mm256_and_si256(v, slash);
+        if (!_mm256_testz_si256(_mm256_shuffle_epi8(lut_lo, ln),
+                                _mm256_shuffle_epi8(lut_hi, hn))) {
+            break;
+        }
+        __m256i roll = _mm256_add_epi8(_mm256_cmpeq_epi8(v, slash), hn);
+        v = _mm256_add_epi8(v, _mm256_shuffle_epi8(lut_roll, roll));
+        v = _mm256_maddubs_epi16(v, _mm256_set1_epi32(0x01400140));
+        v = _mm256_madd_epi16(v, _mm256_set1_epi32(0x00011000));
+        v = _mm256_shuffle_epi8(v, pack);
+        v = _mm256_permutevar8x32_epi32(v, _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 7, 7));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(out), v);
+        out += 24;
+    }
+    return i + decode_base64_sse2(text + i, len - i, out);
+}
+
+const Kernels avx2_kernels = { "avx2", scan_printable_avx2, decode_base64_avx2 };
+
+//
+// AVX-512BW: 64 bytes per step, comparisons produce mask registers directly.
+//
+__attribute__((target("avx512f,avx512bw"))) size_t scan_printable_avx512(const char *buf,
+                                                                          size_t len)
+{
+    const __m512i lo = _mm512_set1_epi8(0x1f);
+    const __m512i hi = _mm512_set1_epi8(0x7f);
+    size_t i         = 0;
+    for (; i + 64 <= len; i += 64) {
+        __m512i v   = _mm512_loadu_si512(buf + i);
+        __mmask64 m = _mm512_cmpgt_epi8_mask(v, lo) & _mm512_cmplt_epi8_mask(v, hi);
+        if (~m != 0) {
+            return i + __builtin_ctzll(~m);
+        }
+    }
+    return i + scan_printable_avx2(buf + i, len - i);
+}
+
+const Kernels avx512_kernels = { "avx512", scan_printable_avx512, decode_base64_avx2 };
+#endif // SIMD_X86
+
+#ifdef SIMD_NEON
+//
+// NEON: 16 bytes per step. There is no movemask, so when a block
+// contains a stop byte, the exact position is found by the scalar code.
+//
+size_t scan_printable_neon(const char *buf, size_t len)
+{
+    const int8x16_t lo = vdupq_n_s8(0x1f);
+    const int8x16_t hi = vdupq_n_s8(0x7f);
+    size_t i           = 0;
+    for (; i + 16 <= len; i += 16) {
+        int8x16_t v  = vld1q_s8(reinterpret_cast<const int8_t *>(buf + i));
+        uint8x16_t m = vandq_u8(vcgtq_s8(v, lo), vcltq_s8(v, hi));
+        if (vminvq_u8(m) != 0xff) {
+            break;
+        }
+    }
+    return i + scan_printable_scalar(buf + i, len - i);
+}
+
+const Kernels neon_kernels = { "neon", scan_printable_neon, decode_base64_scalar };
+#endif // SIMD_NEON
+
+//
+// All kernel sets supported by this CPU, best first.
+//
+std::vector<const Kernels *> detect_kernels()
+{
+    std::vector<const Kernels *> list;
+#ifdef SIMD_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512bw")) {
+        list.push_back(&avx512_kernels);
+    }
+    if (__builtin_cpu_supports("avx2")) {
+        list.push_back(&avx2_kernels);
+    }
+    if (__builtin_cpu_supports("sse2")) {
+        list.push_back(&sse2_kernels);
+    }
+#endif
+#ifdef SIMD_NEON
+    list.push_back(&neon_kernels);
+#endif
+    list.push_back(&scalar_kernels);
+    return list;
+}
+
+//
+// Currently selected kernel set, resolved on first use.
+//
+const Kernels *&current()
+{
+    static const Kernels *selected = detect_kernels().front();
+    return selected;
+}
+
+} // namespace
+
+size_t scan_printable(const char *buf, size_t len)
+{
+    return current()->scan_printable(buf, len);
+}
+
+size_t decode_base64(const char *text, size_t len, uint8_t *out)
+{
+    return current()->decode_base64(text, len, out);
+}
+
+int base64_value(char c)
+{
+    return base64_table.value[static_cast<uint8_t>(c)];
+}
+
+const char *kernel_name()
+{
+    return current()->name;
+}
+
+std::vector<std::string> supported_kernels()
+{
+    std::vector<std::string> names;
+    for (auto *k : detect_kernels()) {
+        names.push_back(k->name);
+    }
+    return names;
+}
+
+bool select_kernel(const std::string &name)
+{
+    for (auto *k : detect_kernels()) {
+        if (name == k->name) {
+            current() = k;
+            return true;
+        }
+    }
+    return false;
+}
+
+} // namespace simd
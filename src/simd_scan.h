@@ -0,0 +1,60 @@
+//
+// Vectorized scanning kernels with run-time CPU dispatch.
+//
+// Copyright (c) 2025 Serge Vakulenko
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef SIMD_SCAN_H
+#define SIMD_SCAN_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+//
+// Every kernel has a scalar reference implementation and a few ISA variants.
+// The best variant supported by the CPU is selected once, on first use.
+//
+namespace simd {
+
+// Return length of the leading run of printable ASCII bytes (0x20...0x7e).
+size_t scan_printable(const char *buf, size_t len);
+
+// Decode leading run of base64 characters (no padding, no line breaks), in groups of four.
+// Return number of characters consumed, a multiple of four; output gets 3/4 of that.
+size_t decode_base64(const char *text, size_t len, uint8_t *out);
+
+// Value of a base64 character, or -1 for anything else.
+int base64_value(char c);
+
+// Name of the currently selected kernel set: "scalar", "sse2", "avx2", "avx512" or "neon".
+const char *kernel_name();
+
+// List of kernel sets supported by this CPU, best first; "scalar" is always the last.
+std::vector<std::string> supported_kernels();
+
+// Force a kernel set by name, for tests and benchmarks.
+// Return false when it's not supported by this CPU.
+bool select_kernel(const std::string &name);
+
+} // namespace simd
+
+#endif // SIMD_SCAN_H
@@ -0,0 +1,395 @@
+//
+// Client of tmux control mode: panes are emulated and rendered natively.
+//
+// Copyright (c) 2025 Serge Vakulenko
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include "tmux_control.h"
+
+#include "memory_governor.h"
+
+#include <algorithm>
+#include <cstring>
+
+// Parse decimal number, and advance.
+static bool parse_number(std::string_view &s, int &value)
+{
+    size_t n = 0;
+    value    = 0;
+    while (n < s.size() && s[n] >= '0' && s[n] <= '9') {
+        value = value * 10 + (s[n] - '0');
+        ++n;
+    }
+    s.remove_prefix(n);
+    return n > 0;
+}
+
+// Parse number after given prefix, like "%12" or "@3".
+static bool parse_id(std::string_view s, char prefix, int &value)
+{
+    if (s.empty() || s[0] != prefix)
+        return false;
+    s.remove_prefix(1);
+    return parse_number(s, value);
+}
+
+static bool skip_char(std::string_view &s, char c)
+{
+    if (s.empty() || s[0] != c)
+        return false;
+    s.remove_prefix(1);
+    return true;
+}
+
+//
+// Layout cell: WxH,X,Y followed by ",ID" for a pane,
+// or by a list of cells in {} (side by side) or [] (top to bottom).
+//
+static bool parse_cell(std::string_view &s, std::vector<PaneGeometry> &panes)
+{
+    PaneGeometry g{};
+    if (!parse_number(s, g.width) || !skip_char(s, 'x') || !parse_number(s, g.height) ||
+        !skip_char(s, ',') || !parse_number(s, g.x) || !skip_char(s, ',') ||
+        !parse_number(s, g.y))
+        return false;
+
+    if (skip_char(s, ',')) {
+        if (!parse_number(s, g.id))
+            return false;
+        panes.push_back(g);
+        return true;
+    }
+    char close;
+    if (skip_char(s, '{')) {
+        close = '}';
+    } else if (skip_char(s, '[')) {
+        close = ']';
+    } else {
+        return false;
+    }
+    do {
+        if (!parse_cell(s, panes))
+            return false;
+    } while (skip_char(s, ','));
+    return skip_char(s, close);
+}
+
+//
+// Parse layout like "5c41,80x24,0,0{40x24,0,0,1,39x24,41,0,2}".
+// The leading checksum is ignored.
+//
+bool TmuxControl::parse_layout(std::string_view layout, std::vector<PaneGeometry> &panes)
+{
+    size_t comma = layout.find(',');
+    if (comma == std::string_view::npos)
+        return false;
+    layout.remove_prefix(comma + 1);
+    panes.clear();
+    return parse_cell(layout, panes) && layout.empty();
+}
+
+size_t TmuxControl::start_prefix_length(std::string_view text)
+{
+    size_t length = std::min(text.size(), start_sequence.size() - 1);
+    while (length > 0 && text.substr(text.size() - length) != start_sequence.substr(0, length)) {
+        --length;
+    }
+    return length;
+}
+
+//
+// Bytes of pane output below space, and backslash, come as octal \ooo.
+//
+std::string TmuxControl::unescape(std::string_view text)
+{
+    std::string out;
+    out.reserve(text.size());
+    for (size_t i = 0; i < text.size(); ++i) {
+        if (text[i] == '\\' && i + 3 < text.size() && text[i + 1] >= '0' && text[i + 1] <= '7' &&
+            text[i + 2] >= '0' && text[i + 2] <= '7' && text[i + 3] >= '0' && text[i + 3] <= '7') {
+            out += static_cast<char>((text[i + 1] - '0') * 64 + (text[i + 2] - '0') * 8 +
+                                     (text[i + 3] - '0'));
+            i += 3;
+        } else {
+            out += text[i];
+        }
+    }
+    return out;
+}
+
+std::string TmuxControl::send_keys(int pane, const std::string &bytes)
+{
+    static const char hex[] = "0123456789abcdef";
+    if (bytes.empty())
+        return "";
+
+    std::string command = "send-keys -t %" + std::to_string(pane) + " -H";
+    for (unsigned char c : bytes) {
+        command += ' ';
+        command += hex[c >> 4];
+        command += hex[c & 15];
+    }
+    return command + "\n";
+}
+
+std::string TmuxControl::resize_client(int cols, int rows)
+{
+    return "refresh-client -C " + std::to_string(cols) + "x" + std::to_string(rows) + "\n";
+}
+
+size_t TmuxControl::process_input(const char *data, size_t length, std::vector<int> &dirty_rows)
+{
+    size_t i = 0;
+    while (i < length && active) {
+        if (line.empty() && data[i] == '\033') {
+            // String terminator ESC \ ends control mode.
+            active = false;
+            i++;
+            if (i < length && data[i] == '\\') {
+                i++;
+            }
+            break;
+        }
+        auto newline = static_cast<const char *>(std::memchr(data + i, '\n', length - i));
+        size_t end   = newline ? newline - data : length;
+        line.append(data + i, end - i);
+        if (!newline)
+            return length;
+
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        process_line(line, dirty_rows);
+        line.clear();
+        i = end + 1;
+    }
+    return i;
+}
+
+void TmuxControl::process_line(std::string_view text, std::vector<int> &dirty_rows)
+{
+    if (in_block) {
+        // Reply to our command: not needed.
+        if (text.substr(0, 4) == "%end" || text.substr(0, 6) == "%error") {
+            in_block = false;
+        }
+        return;
+    }
+
+    size_t space          = text.find(' ');
+    std::string_view name = text.substr(0, space);
+    std::string_view args = (space == std::string_view::npos) ? "" : text.substr(space + 1);
+    int window, pane;
+
+    if (name == "%begin") {
+        in_block = true;
+
+    } else if (name == "%output" || name == "%extended-output") {
+        // %output %PANE DATA
+        // %extended-output %PANE AGE ... : DATA
+        auto it = parse_id(args, '%', pane) ? panes.find(pane) : panes.end();
+        if (it == panes.end())
+            return;
+        size_t pos = (name == "%output") ? args.find(' ') : args.find(" : ");
+        if (pos == std::string_view::npos)
+            return;
+        std::string bytes = unescape(args.substr(pos + (name == "%output" ? 1 : 3)));
+
+        auto &p   = it->second;
+        auto rows = p.logic->process_input(bytes.data(), bytes.size());
+        if (is_visible(pane)) {
+            for (int row : rows) {
+                dirty_rows.push_back(p.geometry.y + row);
+            }
+        }
+
+    } else if (name == "%layout-change") {
+        // %layout-change @WINDOW LAYOUT [VISIBLE-LAYOUT FLAGS]
+        if (parse_id(args, '@', window)) {
+            args.remove_prefix(std::min(args.size(), args.find(' ') + 1));
+            change_layout(window, args.substr(0, args.find(' ')), dirty_rows);
+        }
+
+    } else if (name == "%session-window-changed") {
+        // %session-window-changed $SESSION @WINDOW
+        size_t pos = args.find('@');
+        if (pos != std::string_view::npos && parse_id(args.substr(pos), '@', window)) {
+            current_window = window;
+            auto &ids      = window_panes[window];
+            if (!ids.empty() && std::find(ids.begin(), ids.end(), active_pane) == ids.end()) {
+                active_pane = ids.front();
+            }
+            redraw_window(dirty_rows);
+        }
+
+    } else if (name == "%window-pane-changed") {
+        // %window-pane-changed @WINDOW %PANE
+        size_t pos = args.find('%');
+        if (parse_id(args, '@', window) && window == current_window &&
+            pos != std::string_view::npos && parse_id(args.substr(pos), '%', pane)) {
+            active_pane = pane;
+        }
+
+    } else if (name == "%window-close" || name == "%unlinked-window-close") {
+        if (parse_id(args, '@', window)) {
+            for (int id : window_panes[window]) {
+                remove_pane(id);
+            }
+            window_panes.erase(window);
+        }
+    }
+}
+
+TmuxControl::~TmuxControl()
+{
+    for (auto &entry : panes) {
+        MemoryGovernor::instance().remove_client(entry.second.memory_client);
+    }
+}
+
+void TmuxControl::remove_pane(int id)
+{
+    auto it = panes.find(id);
+    if (it != panes.end()) {
+        MemoryGovernor::instance().remove_client(it->second.memory_client);
+        panes.erase(it);
+    }
+}
+
+//
+// Create, resize or remove panes of the window.
+//
+void TmuxControl::change_layout(int window, std::string_view layout,
+                                std::vector<int> &dirty_rows)
+{
+    std::vector<PaneGeometry> geometry;
+    if (!parse_layout(layout, geometry))
+        return;
+
+    std::vector<int> ids;
+    for (const auto &g : geometry) {
+        auto &p = panes[g.id];
+        if (!p.logic) {
+            // History of panes can shrink under memory pressure, like the one of the terminal.
+            p.logic          = std::make_unique<AnsiLogic>(g.width, g.height);
+            AnsiLogic *logic = p.logic.get();
+            p.memory_client  = MemoryGovernor::instance().add_client(
+                "pane history", MemoryGovernor::Kind::HISTORY,
+                [logic] { return logic->memory_in_use(); },
+                [logic](size_t bytes) { return logic->drop_history(bytes); });
+        } else if (p.geometry.width != g.width || p.geometry.height != g.height) {
+            p.logic->resize(g.width, g.height);
+        }
+        p.geometry = g;
+        ids.push_back(g.id);
+    }
+    for (int id : window_panes[window]) {
+        if (std::find(ids.begin(), ids.end(), id) == ids.end()) {
+            remove_pane(id);
+        }
+    }
+    window_panes[window] = ids;
+
+    if (current_window < 0) {
+        current_window = window;
+    }
+    if (window == current_window) {
+        if (std::find(ids.begin(), ids.end(), active_pane) == ids.end()) {
+            active_pane = ids.front();
+        }
+        redraw_window(dirty_rows);
+    }
+}
+
+void TmuxControl::redraw_window(std::vector<int> &dirty_rows) const
+{
+    int height = 0;
+    for (const auto *p : get_visible_panes()) {
+        height = std::max(height, p->geometry.y + p->geometry.height);
+    }
+    for (int row = 0; row <= height; ++row) {
+        dirty_rows.push_back(row);
+    }
+}
+
+bool TmuxControl::is_visible(int pane) const
+{
+    auto it = window_panes.find(current_window);
+    return it != window_panes.end() &&
+           std::find(it->second.begin(), it->second.end(), pane) != it->second.end();
+}
+
+const TmuxPane *TmuxControl::get_pane(int id) const
+{
+    auto it = panes.find(id);
+    return (it == panes.end()) ? nullptr : &it->second;
+}
+
+std::vector<const TmuxPane *> TmuxControl::get_visible_panes() const
+{
+    std::vector<const TmuxPane *> result;
+    auto it = window_panes.find(current_window);
+    if (it != window_panes.end()) {
+        for (int id : it->second) {
+            if (auto *p = get_pane(id)) {
+                result.push_back(p);
+            }
+        }
+    }
+    return result;
+}
+
+//
+// Compose row of the window from rows of the panes.
+// Panes are separated by one cell, where borders are drawn.
+//
+Line TmuxControl::compose_row(int row, int width) const
+{
+    Line result(width, Char{});
+    for (const auto *p : get_visible_panes()) {
+        const auto &g = p->geometry;
+        if (row >= g.y && row < g.y + g.height) {
+            const auto &text = p->logic->get_text_buffer()[row - g.y];
+            for (int col = 0; col < g.width && g.x + col < width; ++col) {
+                result[g.x + col] = text[col];
+            }
+            if (g.x + g.width < width) {
+                result[g.x + g.width].ch = L'│';
+            }
+        } else if (row == g.y + g.height) {
+            for (int col = g.x; col < g.x + g.width && col < width; ++col) {
+                result[col].ch = L'─';
+            }
+        }
+    }
+    return result;
+}
+
+bool TmuxControl::get_cursor(Cursor &cursor) const
+{
+    const TmuxPane *p = get_pane(active_pane);
+    if (!p || !is_visible(active_pane))
+        return false;
+
+    cursor = p->logic->get_cursor();
+    cursor.row += p->geometry.y;
+    cursor.col += p->geometry.x;
+    return true;
+}
@@ -0,0 +1,110 @@
+//
+// Client of tmux control mode: panes are emulated and rendered natively.
+//
+// Copyright (c) 2025 Serge Vakulenko
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef TMUX_CONTROL_H
+#define TMUX_CONTROL_H
+
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "ansi_logic.h"
+
+// Position and size of a pane in the tmux window, in cells
+struct PaneGeometry {
+    int id;
+    int x, y;
+    int width, height;
+};
+
+// Pane with its own terminal logic and scrollback
+struct TmuxPane {
+    PaneGeometry geometry;
+    std::unique_ptr<AnsiLogic> logic;
+    int memory_client{}; // History is a client of memory governor
+};
+
+//
+// Started by "tmux -CC", tmux sends notifications line by line inside
+// DCS sequence "ESC P 1000 p" ... "ESC \". Output of every pane arrives
+// as "%output %PANE data", so each pane is emulated separately, instead
+// of emulating tmux redrawing the whole screen.
+//
+class TmuxControl {
+public:
+    // Start of control mode in terminal output
+    static constexpr std::string_view start_sequence = "\033P1000p";
+
+    TmuxControl() = default;
+    TmuxControl(const TmuxControl &) = delete;
+    TmuxControl &operator=(const TmuxControl &) = delete;
+    ~TmuxControl();
+
+    // Process data from tmux, and collect dirty rows of the window.
+    // Return number of bytes consumed: less than length when control mode ends,
+    // and the rest of data belongs to the terminal.
+    size_t process_input(const char *data, size_t length, std::vector<int> &dirty_rows);
+    bool is_active() const { return active; }
+
+    // Panes of the current window
+    const TmuxPane *get_pane(int id) const;
+    std::vector<const TmuxPane *> get_visible_panes() const;
+    int get_active_pane() const { return active_pane; }
+
+    // Row of the window, composed of panes and borders between them.
+    Line compose_row(int row, int width) const;
+    bool get_cursor(Cursor &cursor) const;
+
+    // Commands to tmux
+    static std::string send_keys(int pane, const std::string &bytes);
+    static std::string resize_client(int cols, int rows);
+
+    // Helpers, exposed for tests
+    static bool parse_layout(std::string_view layout, std::vector<PaneGeometry> &panes);
+    static std::string unescape(std::string_view text);
+
+    // Length of the end of text which may begin the start sequence,
+    // split from the rest of it by a read.
+    static size_t start_prefix_length(std::string_view text);
+
+private:
+    FRIEND_TEST(TmuxControlTest, ParsesNotifications);
+
+    bool active{ true };
+    std::string line;                             // Incomplete line from previous input
+    bool in_block{};                              // Inside %begin...%end reply to a command
+    int current_window{ -1 };                     // Window shown
+    int active_pane{ -1 };                        // Pane which gets keyboard input
+    std::map<int, TmuxPane> panes;                // By pane id
+    std::map<int, std::vector<int>> window_panes; // Pane ids by window id
+
+    void process_line(std::string_view text, std::vector<int> &dirty_rows);
+    void remove_pane(int id);
+    void change_layout(int window, std::string_view layout, std::vector<int> &dirty_rows);
+    void redraw_window(std::vector<int> &dirty_rows) const;
+    bool is_visible(int pane) const;
+};
+
+#endif // TMUX_CONTROL_H
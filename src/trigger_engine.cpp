@@ -0,0 +1,145 @@
+//
+// Output triggers: multi-pattern matching of terminal output.
+//
+// Copyright (c) 2025 Serge Vakulenko
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include "trigger_engine.h"
+
+#include <algorithm>
+
+TriggerEngine::TriggerEngine()
+{
+    compile();
+}
+
+int TriggerEngine::add_pattern(const std::string &pattern)
+{
+    patterns.push_back(pattern);
+    compiled = false;
+    return patterns.size() - 1;
+}
+
+//
+// Build trie of all patterns, then turn it into automaton:
+// breadth-first, missing transitions are copied from the state
+// of the longest proper suffix.
+//
+void TriggerEngine::compile()
+{
+    transitions.assign(256, -1);
+    output.assign(1, -1);
+    for (size_t p = 0; p < patterns.size(); ++p) {
+        int s = 0;
+        for (unsigned char c : patterns[p]) {
+            if (transitions[s * 256 + c] < 0) {
+                transitions[s * 256 + c] = output.size();
+                transitions.resize(transitions.size() + 256, -1);
+                output.push_back(-1);
+            }
+            s = transitions[s * 256 + c];
+        }
+        if (output[s] < 0 && !patterns[p].empty()) {
+            output[s] = p;
+        }
+    }
+
+    std::vector<int> fail(output.size(), 0);
+    std::vector<int> queue;
+    for (int c = 0; c < 256; ++c) {
+        int &next = transitions[c];
+        if (next < 0) {
+            next = 0;
+        } else {
+            queue.push_back(next);
+        }
+    }
+    for (size_t head = 0; head < queue.size(); ++head) {
+        int s = queue[head];
+        // Patterns matched at the suffix state end here as well.
+        int inherited = output[fail[s]];
+        if (inherited >= 0 && (output[s] < 0 || inherited < output[s])) {
+            output[s] = inherited;
+        }
+        for (int c = 0; c < 256; ++c) {
+            int &next = transitions[s * 256 + c];
+            if (next < 0) {
+                next = transitions[fail[s] * 256 + c];
+            } else {
+                fail[next] = transitions[fail[s] * 256 + c];
+                queue.push_back(next);
+            }
+        }
+    }
+    state    = 0;
+    compiled = true;
+}
+
+int TriggerEngine::feed(const char *text, size_t length)
+{
+    if (!compiled) {
+        compile();
+    }
+    int match = -1;
+    for (size_t i = 0; i < length; ++i) {
+        state = transitions[state * 256 + static_cast<unsigned char>(text[i])];
+        if (output[state] >= 0 && (match < 0 || output[state] < match)) {
+            match = output[state];
+        }
+    }
+    return match;
+}
+
+//
+// Feed a row of the screen, encoded as UTF-8.
+//
+int TriggerEngine::feed(const Line &line)
+{
+    char buf[4];
+    int match = -1;
+    for (const auto &c : line) {
+        wchar_t wc = c.ch;
+        size_t n;
+        if (wc <= 0x7F) {
+            buf[0] = wc;
+            n      = 1;
+        } else if (wc <= 0x7FF) {
+            buf[0] = 0xC0 | ((wc >> 6) & 0x1F);
+            buf[1] = 0x80 | (wc & 0x3F);
+            n      = 2;
+        } else if (wc <= 0xFFFF) {
+            buf[0] = 0xE0 | ((wc >> 12) & 0x0F);
+            buf[1] = 0x80 | ((wc >> 6) & 0x3F);
+            buf[2] = 0x80 | (wc & 0x3F);
+            n      = 3;
+        } else {
+            buf[0] = 0xF0 | ((wc >> 18) & 0x07);
+            buf[1] = 0x80 | ((wc >> 12) & 0x3F);
+            buf[2] = 0x80 | ((wc >> 6) & 0x3F);
+            buf[3] = 0x80 | (wc & 0x3F);
+            n      = 4;
+        }
+        int m = feed(buf, n);
+        if (m >= 0 && (match < 0 || m < match)) {
+            match = m;
+        }
+    }
+    return match;
+}
@@ -0,0 +1,65 @@
+//
+// Output triggers: multi-pattern matching of terminal output.
+//
+// Copyright (c) 2025 Serge Vakulenko
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#ifndef TRIGGER_ENGINE_H
+#define TRIGGER_ENGINE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "ansi_logic.h"
+
+//
+// Set of patterns, compiled into Aho-Corasick automaton over UTF-8 bytes.
+// Transitions are a full table, so every byte of text costs one lookup,
+// no matter how many patterns there are.
+// Matching is streaming: state is kept between calls until reset().
+//
+class TriggerEngine {
+public:
+    TriggerEngine();
+
+    // Add pattern, return its index.
+    int add_pattern(const std::string &pattern);
+    const std::string &get_pattern(int index) const { return patterns[index]; }
+    size_t get_pattern_count() const { return patterns.size(); }
+
+    // Feed text, return index of the first pattern matched, or -1.
+    int feed(const char *text, size_t length);
+    int feed(const Line &line);
+
+    // Start matching a new line.
+    void reset() { state = 0; }
+
+private:
+    std::vector<std::string> patterns;
+    bool compiled{};
+    std::vector<int32_t> transitions; // 256 entries per state
+    std::vector<int> output;          // Lowest pattern index matched at state, or -1
+    int state{};
+
+    void compile();
+};
+
+#endif // TRIGGER_ENGINE_H
@@ -23,7 +23,21 @@
 //
 #include <gtest/gtest.h>
 
+#include <random>
+
 #include "ansi_logic.h"
+#include "bench_corpus.h"
+#include "frame_scheduler.h"
+#include "inline_image.h"
+#include "link_detector.h"
+#include "local_echo.h"
+#include "memory_governor.h"
+#include "output_queue.h"
+#include "png_writer.h"
+#include "reference_logic.h"
+#include "simd_scan.h"
+#include "tmux_control.h"
+#include "trigger_engine.h"
 
 // Test fixture for AnsiLogic
 class AnsiLogicTest : public ::testing::Test {
@@ -390,6 +404,1414 @@ TEST_F(AnsiLogicTest, Utf8Input)
     EXPECT_EQ(logic->text_buffer[5][13].ch, 0x1F600); // 😀
 }
 
+// Test long ASCII run wrapping to the next line
+TEST_F(AnsiLogicTest, AsciiRunWraps)
+{
+    std::string text(logic->get_cols() + 5, 'a');
+    text += "\x01" "b";
+    logic->cursor = { 5, 3 };
+    auto dirty_rows = logic->process_input(text.data(), text.size());
+
+    EXPECT_EQ(logic->text_buffer[5][2].ch, L' ');
+    for (int c = 3; c < logic->get_cols(); ++c) {
+        EXPECT_EQ(logic->text_buffer[5][c].ch, L'a');
+    }
+    for (int c = 0; c < 8; ++c) {
+        EXPECT_EQ(logic->text_buffer[6][c].ch, L'a');
+    }
+    EXPECT_EQ(logic->text_buffer[6][8].ch, 1);
+    EXPECT_EQ(logic->text_buffer[6][9].ch, L'b');
+    EXPECT_EQ(logic->cursor.row, 6);
+    EXPECT_EQ(logic->cursor.col, 10);
+    EXPECT_EQ(dirty_rows, std::vector<int>({ 5, 6 }));
+}
+
+// Test lines scrolled off the screen are kept in history
+TEST_F(AnsiLogicTest, ScrollbackHistory)
+{
+    logic->set_history_limit(3);
+    for (int n = 0; n < 30; ++n) {
+        std::string line = "line " + std::to_string(n) + "\r\n";
+        logic->process_input(line.data(), line.size());
+    }
+
+    // Screen has lines 7...29 and empty last line, history has 4...6
+    ASSERT_EQ(logic->get_history_size(), 3);
+    EXPECT_EQ(logic->get_history_line(0)[5].ch, L'4');
+    EXPECT_EQ(logic->get_history_line(1)[5].ch, L'5');
+    EXPECT_EQ(logic->get_history_line(2)[5].ch, L'6');
+    EXPECT_EQ(logic->get_text_buffer()[0][5].ch, L'7');
+    EXPECT_EQ(logic->get_text_buffer()[22][6].ch, L'9');
+    EXPECT_EQ(logic->get_text_buffer()[23][0].ch, L' ');
+
+    logic->set_history_limit(1);
+    ASSERT_EQ(logic->get_history_size(), 1);
+    EXPECT_EQ(logic->get_history_line(0)[5].ch, L'6');
+}
+
+// Test OSC 133 marks: prompt navigation and output of the last command
+TEST_F(AnsiLogicTest, ShellIntegrationMarks)
+{
+    // Three commands, each with two lines of output; ST and BEL terminators.
+    for (int n = 0; n < 3; ++n) {
+        std::string text = "\033]133;A\033\\$ \033]133;B\7cmd" + std::to_string(n) +
+                           "\r\n\033]133;C\7out " + std::to_string(n) + "\r\nend " +
+                           std::to_string(n) + "  \r\n\033]133;D;0\7";
+        logic->process_input(text.data(), text.size());
+    }
+    EXPECT_EQ(logic->get_text_buffer()[0][0].ch, L'$');
+    EXPECT_EQ(logic->get_text_buffer()[1][0].ch, L'o');
+    EXPECT_EQ(logic->last_command_output(), "out 2\nend 2\n");
+
+    // Prompts are at lines 0, 3 and 6.
+    EXPECT_EQ(logic->find_prompt(5, false), 3);
+    EXPECT_EQ(logic->find_prompt(3, false), 0);
+    EXPECT_EQ(logic->find_prompt(0, false), -1);
+    EXPECT_EQ(logic->find_prompt(3, true), 6);
+    EXPECT_EQ(logic->find_prompt(6, true), -1);
+
+    // Absolute line numbers survive scrolling into history.
+    std::string text(30, '\n');
+    logic->process_input(text.data(), text.size());
+    EXPECT_EQ(logic->first_line(), 0);
+    EXPECT_EQ(logic->find_prompt(100, false), 6);
+    ASSERT_NE(logic->get_line(6), nullptr);
+    EXPECT_EQ((*logic->get_line(6))[2].ch, L'c');
+    EXPECT_EQ(logic->last_command_output(), "out 2\nend 2\n");
+
+    // Marks of dropped lines are not found.
+    logic->set_history_limit(5);
+    EXPECT_EQ(logic->first_line(), 11);
+    EXPECT_EQ(logic->find_prompt(100, false), -1);
+    EXPECT_EQ(logic->get_line(0), nullptr);
+}
+
+// Test a burst of bells is reported once, and changes no rows
+TEST_F(AnsiLogicTest, BellIsCoalesced)
+{
+    EXPECT_FALSE(logic->take_bell());
+    std::string text(1000, '\7');
+    EXPECT_TRUE(logic->process_input(text.data(), text.size()).empty());
+    EXPECT_TRUE(logic->take_bell());
+    EXPECT_FALSE(logic->take_bell());
+}
+
+// Test memory of the session is counted, and trimmed after shrinking the screen
+TEST_F(AnsiLogicTest, SessionMemoryAccounting)
+{
+    const size_t screen_bytes = 80 * 24 * sizeof(Char);
+    EXPECT_GE(logic->memory_in_use(), screen_bytes);
+    EXPECT_GE(logic->memory_reserved(), logic->memory_in_use());
+
+    // History grows memory by a line for every line scrolled.
+    size_t before = logic->memory_in_use();
+    std::string text(100, '\n');
+    logic->process_input(text.data(), text.size());
+    EXPECT_GE(logic->memory_in_use(), before + (100 - 23) * 80 * sizeof(Char));
+
+    // Narrow screen: after trimming, only new width is kept for the screen.
+    logic->set_history_limit(0);
+    logic->resize(10, 24);
+    logic->trim_memory();
+    EXPECT_GE(logic->memory_in_use(), 10 * 24 * sizeof(Char));
+    EXPECT_LT(logic->memory_in_use(), screen_bytes / 2);
+    EXPECT_LT(logic->memory_reserved(), screen_bytes);
+}
+
+// Test trimming memory between reflows, which leaves no buffers in the released arena
+TEST_F(AnsiLogicTest, TrimBetweenResizes)
+{
+    std::string text;
+    for (int n = 0; n < 3000; ++n) {
+        text += "line " + std::to_string(n) + "\r\n";
+    }
+    logic->process_input(text.data(), text.size());
+    logic->resize(60, 24);
+    logic->trim_memory();
+    logic->resize(90, 24);
+    logic->trim_memory();
+    int64_t first = logic->first_line();
+    logic->resize(40, 24);
+    EXPECT_EQ(logic->get_history_size(), 3001 - 24);
+    int64_t line = logic->reflowed_line(first + 2999);
+    EXPECT_EQ((*logic->get_line(line))[5].ch, L'2');
+    EXPECT_EQ((*logic->get_line(line))[8].ch, L'9');
+}
+
+// Test memory governor evicts background history first
+TEST(MemoryGovernorTest, EvictsColdestFirst)
+{
+    MemoryGovernor governor;
+    AnsiLogic focused(80, 24), background(80, 24);
+    std::string text(1000, '\n');
+    focused.process_input(text.data(), text.size());
+    background.process_input(text.data(), text.size());
+
+    std::vector<std::string> evicted;
+    auto add_session = [&](const char *name, AnsiLogic &logic) {
+        return governor.add_client(
+            name, MemoryGovernor::Kind::HISTORY, [&logic] { return logic.memory_in_use(); },
+            [&evicted, &logic, name](size_t bytes) {
+                evicted.push_back(name);
+                return logic.drop_history(bytes);
+            });
+    };
+    int focused_id = add_session("focused", focused);
+    add_session("background", background);
+    governor.set_focused(focused_id, true);
+
+    // Fits the budget: nothing evicted.
+    size_t usage = focused.memory_in_use() + background.memory_in_use();
+    governor.set_budget(usage);
+    EXPECT_TRUE(governor.enforce());
+    EXPECT_TRUE(evicted.empty());
+
+    // Over the budget by half of background history.
+    size_t history_bytes = background.memory_in_use() - 80 * 24 * sizeof(Char);
+    governor.set_budget(usage - history_bytes / 2);
+    EXPECT_TRUE(governor.enforce());
+    EXPECT_EQ(evicted, std::vector<std::string>({ "background" }));
+    EXPECT_EQ(focused.get_history_size(), 1000 - 23);
+    EXPECT_LT(background.get_history_size(), 1000 - 23);
+    EXPECT_GT(background.get_history_size(), 0);
+
+    // Over the budget by more than whole background history.
+    evicted.clear();
+    governor.set_budget(usage - history_bytes * 3 / 2);
+    EXPECT_TRUE(governor.enforce());
+    EXPECT_EQ(evicted, std::vector<std::string>({ "background", "focused" }));
+    EXPECT_EQ(background.get_history_size(), 0);
+    EXPECT_GT(focused.get_history_size(), 0);
+
+    // Screens can't be evicted.
+    governor.set_budget(1);
+    EXPECT_FALSE(governor.enforce());
+    EXPECT_EQ(focused.get_history_size(), 0);
+
+    auto stats = governor.get_stats();
+    EXPECT_EQ(stats.clients, 2u);
+    EXPECT_EQ(stats.evictions, 4u);
+    EXPECT_LT(stats.usage, usage / 10);
+}
+
+// Generate random terminal output: text, UTF-8, controls and escape sequences
+static std::string random_output(std::mt19937 &rng, size_t length)
+{
+    static const char *const utf8[] = { "\xD0\xAF", "\xE2\x82\xAC", "\xF0\x9F\x98\x80",
+                                        "\xC3\xA9", "\xE4\xB8\xAD" };
+    static const std::string finals = "mHABCDJKfG`dbXP@LMSTrsu";
+    static const char *const escapes[] = { "\0337", "\0338", "\033D", "\033E", "\033M",
+                                           "\033[?69h", "\033[?69l", "\033[?69h\033[3;9s" };
+    std::string out;
+    while (out.size() < length) {
+        switch (rng() % 11) {
+        case 0:
+        case 1:
+        case 2:
+            // Printable ASCII, sometimes longer than a line
+            for (unsigned n = rng() % (rng() % 4 ? 20 : 200); n > 0; --n) {
+                out += static_cast<char>(' ' + rng() % 95);
+            }
+            break;
+        case 3:
+            out += utf8[rng() % 5];
+            break;
+        case 4:
+            out += "\r\n"[rng() % 2];
+            break;
+        case 5:
+            out += "\b\t\7\x01\x7f\x80\xff"[rng() % 7];
+            break;
+        case 6:
+            out += "\r\n";
+            break;
+        case 7:
+        case 8: {
+            // CSI sequence with random parameters
+            out += "\033[";
+            for (unsigned n = rng() % 3; n > 0; --n) {
+                out += std::to_string(rng() % 2 ? rng() % 10 : rng() % 110);
+                if (n > 1) {
+                    out += ';';
+                }
+            }
+            out += finals[rng() % finals.size()];
+            break;
+        }
+        case 9:
+            out += rng() % 8 ? "\033[0m" : "\033c";
+            break;
+        case 10:
+            // Save and restore, index, left and right margin mode
+            out += escapes[rng() % 8];
+            break;
+        }
+    }
+    return out;
+}
+
+// Compare optimized parser against the reference model, on random chunk boundaries
+TEST_F(AnsiLogicTest, MatchesReferenceModel)
+{
+    std::mt19937 rng(2025);
+    for (int iteration = 0; iteration < 200; ++iteration) {
+        int cols = 1 + rng() % 100;
+        int rows = 1 + rng() % 30;
+        AnsiLogic fast(cols, rows);
+        ReferenceLogic reference(cols, rows);
+
+        std::string input = random_output(rng, 1 + rng() % 4000);
+        for (size_t pos = 0; pos < input.size();) {
+            size_t chunk = std::min<size_t>(input.size() - pos, 1 + rng() % 300);
+            fast.process_input(&input[pos], chunk);
+            reference.process_input(&input[pos], chunk);
+            pos += chunk;
+
+            ASSERT_EQ(fast.cursor.row, reference.get_cursor().row) << "at byte " << pos;
+            ASSERT_EQ(fast.cursor.col, reference.get_cursor().col) << "at byte " << pos;
+            ASSERT_EQ(fast.current_attr, reference.get_attr()) << "at byte " << pos;
+            for (int r = 0; r < rows; ++r) {
+                for (int c = 0; c < cols; ++c) {
+                    const auto &a = fast.text_buffer[r][c];
+                    const auto &b = reference.get_text_buffer()[r][c];
+                    ASSERT_TRUE(a.ch == b.ch && a.attr == b.attr)
+                        << "cell " << r << "," << c << " at byte " << pos;
+                }
+            }
+        }
+    }
+}
+
+// Test every SIMD kernel supported by this CPU against the scalar one
+TEST(SimdScanTest, KernelsMatchScalar)
+{
+    std::mt19937 rng(12345);
+    std::vector<std::string> inputs;
+    for (int n = 0; n < 300; ++n) {
+        std::string buf(rng() % 200, 'x');
+        for (auto &c : buf) {
+            c = ' ' + rng() % 95;
+        }
+        if (!buf.empty() && rng() % 4 != 0) {
+            // Plant a stop byte: control, DEL or high-bit.
+            static const char stops[] = { '\0', '\n', '\033', '\x1f', '\x7f', '\x80', '\xff' };
+            buf[rng() % buf.size()] = stops[rng() % sizeof(stops)];
+        }
+        inputs.push_back(buf);
+    }
+
+    std::string saved = simd::kernel_name();
+    ASSERT_TRUE(simd::select_kernel("scalar"));
+    std::vector<size_t> expected;
+    for (const auto &buf : inputs) {
+        expected.push_back(simd::scan_printable(buf.data(), buf.size()));
+    }
+    for (const auto &name : simd::supported_kernels()) {
+        ASSERT_TRUE(simd::select_kernel(name));
+        for (size_t n = 0; n < inputs.size(); ++n) {
+            EXPECT_EQ(simd::scan_printable(inputs[n].data(), inputs[n].size()), expected[n])
+                << "kernel " << name << ", input " << n;
+        }
+    }
+    simd::select_kernel(saved);
+}
+
+// Test base64 decoding by every kernel against the scalar one
+TEST(SimdScanTest, Base64MatchesScalar)
+{
+    static const char alphabet[] =
+        "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    std::mt19937 rng(54321);
+    std::vector<std::string> inputs;
+    for (int n = 0; n < 300; ++n) {
+        std::string text(rng() % 400, 'A');
+        for (auto &c : text) {
+            c = alphabet[rng() % 64];
+        }
+        if (!text.empty() && rng() % 4 != 0) {
+            // Plant a character out of the alphabet.
+            static const char stops[] = { '=', '\n', '\0', '-', '_', '.', '\x80', '\xff',
+                                          '@', '[', '`', '{', '*', ',', ':' };
+            text[rng() % text.size()] = stops[rng() % sizeof(stops)];
+        }
+        inputs.push_back(text);
+    }
+
+    std::string saved = simd::kernel_name();
+    ASSERT_TRUE(simd::select_kernel("scalar"));
+    std::vector<std::vector<uint8_t>> expected;
+    for (const auto &text : inputs) {
+        std::vector<uint8_t> out(text.size() / 4 * 3);
+        out.resize(simd::decode_base64(text.data(), text.size(), out.data()) / 4 * 3);
+        expected.push_back(out);
+    }
+    for (const auto &name : simd::supported_kernels()) {
+        ASSERT_TRUE(simd::select_kernel(name));
+        for (size_t n = 0; n < inputs.size(); ++n) {
+            std::vector<uint8_t> out(inputs[n].size() / 4 * 3);
+            size_t count = simd::decode_base64(inputs[n].data(), inputs[n].size(), out.data());
+            out.resize(count / 4 * 3);
+            EXPECT_EQ(out, expected[n]) << "kernel " << name << ", input " << n;
+        }
+    }
+    simd::select_kernel(saved);
+
+    uint8_t out[3];
+    EXPECT_EQ(simd::decode_base64("TWFu", 4, out), 4u);
+    EXPECT_EQ(std::string(out, out + 3), "Man");
+}
+
+//
+// Encode data as base64, with padding.
+//
+static std::string base64_encode(const std::string &data)
+{
+    static const char alphabet[] =
+        "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    std::string text;
+    for (size_t i = 0; i < data.size(); i += 3) {
+        uint32_t v = uint8_t(data[i]) << 16;
+        if (i + 1 < data.size())
+            v |= uint8_t(data[i + 1]) << 8;
+        if (i + 2 < data.size())
+            v |= uint8_t(data[i + 2]);
+        text += alphabet[v >> 18];
+        text += alphabet[(v >> 12) & 63];
+        text += (i + 1 < data.size()) ? alphabet[(v >> 6) & 63] : '=';
+        text += (i + 2 < data.size()) ? alphabet[v & 63] : '=';
+    }
+    return text;
+}
+
+//
+// Make 24-bit BMP file, where pixel (x, y) has color (x, y, x + y).
+//
+static std::string make_bmp(int width, int height)
+{
+    int row_size = (width * 3 + 3) & ~3;
+    std::string file(54 + row_size * height, '\0');
+    auto put32   = [&file](int offset, uint32_t value) {
+        for (int k = 0; k < 4; ++k) {
+            file[offset + k] = value >> (8 * k);
+        }
+    };
+    file[0] = 'B';
+    file[1] = 'M';
+    put32(2, file.size());
+    put32(10, 54);
+    put32(14, 40);
+    put32(18, width);
+    put32(22, height);
+    file[26] = 1;
+    file[28] = 24;
+    for (int y = 0; y < height; ++y) {
+        char *row = &file[54 + (height - 1 - y) * row_size];
+        for (int x = 0; x < width; ++x) {
+            row[x * 3]     = x + y;
+            row[x * 3 + 1] = y;
+            row[x * 3 + 2] = x;
+        }
+    }
+    return file;
+}
+
+// Test image is decoded the same, however the payload is split
+TEST(InlineImageTest, StreamedBmp)
+{
+    std::string text = base64_encode(make_bmp(37, 5));
+    text.insert(100, "\r\n");
+
+    ImageDecoder whole(1 << 20);
+    whole.feed_base64(text.data(), text.size());
+    auto image = whole.finish();
+    ASSERT_NE(image, nullptr);
+    EXPECT_EQ(image->width, 37);
+    EXPECT_EQ(image->height, 5);
+    const uint8_t *pixel = &image->pixels[(3 * 37 + 20) * 4];
+    EXPECT_EQ(pixel[0], 20);
+    EXPECT_EQ(pixel[1], 3);
+    EXPECT_EQ(pixel[2], 23);
+    EXPECT_EQ(pixel[3], 255);
+
+    ImageDecoder split(1 << 20);
+    for (size_t i = 0; i < text.size(); i += 7) {
+        split.feed_base64(&text[i], std::min<size_t>(7, text.size() - i));
+    }
+    auto copy = split.finish();
+    ASSERT_NE(copy, nullptr);
+    EXPECT_EQ(copy->hash, image->hash);
+    EXPECT_EQ(copy->pixels, image->pixels);
+
+    // Too large, or not an image
+    ImageDecoder small(500);
+    small.feed_base64(text.data(), text.size());
+    EXPECT_EQ(small.finish(), nullptr);
+    EXPECT_TRUE(small.failed());
+    ImageDecoder junk(1 << 20);
+    junk.feed_base64("SGVsbG8gd29ybGQ=", 16);
+    EXPECT_EQ(junk.finish(), nullptr);
+
+    // Height which can't be negated
+    std::string file = make_bmp(4, 4);
+    file[22] = file[23] = file[24] = 0;
+    file[25] = '\x80';
+    text     = base64_encode(file);
+    ImageDecoder bad_height(1 << 20);
+    bad_height.feed_base64(text.data(), text.size());
+    EXPECT_EQ(bad_height.finish(), nullptr);
+    EXPECT_TRUE(bad_height.failed());
+}
+
+// Test PNG images: deflate blocks of every type, row filters, and palette
+TEST(InlineImageTest, DecodesPng)
+{
+    auto decode = [](const std::string &text) {
+        ImageDecoder decoder(1 << 20);
+        for (size_t i = 0; i < text.size(); i += 7) {
+            decoder.feed_base64(&text[i], std::min<size_t>(7, text.size() - i));
+        }
+        return decoder.finish();
+    };
+
+    // Written by encode_png: fixed codes, filter Up.
+    std::vector<uint8_t> rgb(5 * 4 * 3);
+    for (size_t i = 0; i < rgb.size(); ++i) {
+        rgb[i] = i * 7;
+    }
+    std::string file = encode_png(rgb.data(), 5, 4, 5 * 3);
+    auto image       = decode(base64_encode(file));
+    ASSERT_NE(image, nullptr);
+    EXPECT_EQ(image->width, 5);
+    EXPECT_EQ(image->height, 4);
+    for (size_t p = 0; p < 5 * 4; ++p) {
+        EXPECT_EQ(image->pixels[4 * p + 1], rgb[3 * p + 1]);
+        EXPECT_EQ(image->pixels[4 * p + 3], 255);
+    }
+
+    // RGBA 16x16 with dynamic codes, and rows filtered by all five filters.
+    image = decode("iVBORw0KGgoAAAANSUhEUgAAABAAAAAQCAYAAAAf8/9hAAABkElEQVR42q3Qq09bcRjG8ef0xmkL"
+                   "7U9gZpqTzNSQNJiZimLIEsyrUUfMYMiRLCSkmZmZqEK/Zv6I/QFN+Aca/oJyK5fe3t4oZaOHN93P"
+                   "bikN4mOffPMAQGSAuQe8lIA/FeA3Ac8+MAuApyowrQGPDExCYFwHRg1g2AQGAogDg7mBE60qpgMR"
+                   "jKNiKq4SKqlSak25Kq0yKqvW1YbKqXwUh4cT141Frhu3ElbSSllrlmulFxKLAk0BtABagMQbEZ4N"
+                   "JWceZZ5KlJ9WaPOR6MPEp8I4oI+jKhWHNdoaMG1LSJ/6dSr3GrTTbdJuR2iv7cDHzCAVreodTvyM"
+                   "42UPc92MlbXW/3WiFmgeoAXQAqT/gzExnBl7vDkqcWFY4eKAeFt8LvcD3u1Vmbo13u8wf2mHfPhQ"
+                   "56P7Bn+7a/KPW+HTloMQY4NstKp3ODHA12UP+2vDyi284UQt0GRAC6AFyFkCMZLve1LolWSrW5Fy"
+                   "h2Sv7cv+QyAH91U5uqvJ91uW01YoP2/q8uu6IWdXTTm/FLm4eAUDdVOi38URwAAAAABJRU5ErkJg"
+                   "gg==");
+    ASSERT_NE(image, nullptr);
+    ASSERT_EQ(image->width, 16);
+    for (int y = 0; y < 16; ++y) {
+        for (int x = 0; x < 16; ++x) {
+            const uint8_t *pixel = &image->pixels[(y * 16 + x) * 4];
+            EXPECT_EQ(pixel[0], (x * 16) & 255);
+            EXPECT_EQ(pixel[1], (y * 16) & 255);
+            EXPECT_EQ(pixel[2], (x * y) & 255);
+            EXPECT_EQ(pixel[3], 255 - x - y);
+        }
+    }
+
+    // Palette of 2-bit indices with transparency, in a stored block.
+    image = decode("iVBORw0KGgoAAAANSUhEUgAAAAUAAAADAgMAAAAmWC1rAAAADFBMVEX/AAAA/wAAAP8JCQlccX6G"
+                   "AAAAAnRSTlP/gAgPs2oAAAAUSURBVHgBAQkA9v8AGwAAbEAAsYAF3wH5H86UfwAAAABJRU5ErkJg"
+                   "gg==");
+    ASSERT_NE(image, nullptr);
+    EXPECT_EQ(image->width, 5);
+    EXPECT_EQ(image->height, 3);
+    const uint8_t *pixel = &image->pixels[1 * 4];
+    EXPECT_EQ(std::vector<uint8_t>(pixel, pixel + 4), std::vector<uint8_t>({ 0, 255, 0, 128 }));
+    pixel = &image->pixels[(2 * 5 + 4) * 4];
+    EXPECT_EQ(std::vector<uint8_t>(pixel, pixel + 4), std::vector<uint8_t>({ 0, 0, 255, 255 }));
+
+    // 16-bit gray, with one transparent value
+    image = decode("iVBORw0KGgoAAAANSUhEUgAAAAMAAAACEAAAAADoj+WFAAAAAnRSTlMSNC/TSV4AAAAWSURBVHja"
+                   "YxAyETL9/5+BgUHIpIEBABkTA1L20lFjAAAAAElFTkSuQmCC");
+    ASSERT_NE(image, nullptr);
+    std::vector<uint8_t> gray, alpha;
+    for (size_t p = 0; p < 6; ++p) {
+        gray.push_back(image->pixels[4 * p]);
+        alpha.push_back(image->pixels[4 * p + 3]);
+    }
+    EXPECT_EQ(gray, std::vector<uint8_t>({ 0x12, 0x12, 0xff, 0, 0x12, 0x80 }));
+    EXPECT_EQ(alpha, std::vector<uint8_t>({ 0, 255, 255, 255, 0, 255 }));
+
+    // Damaged data, or too large
+    file[file.size() - 20] ^= 1;
+    EXPECT_EQ(decode(base64_encode(file)), nullptr);
+    ImageDecoder small(50);
+    std::string text = base64_encode(encode_png(rgb.data(), 5, 4, 5 * 3));
+    small.feed_base64(text.data(), text.size());
+    EXPECT_EQ(small.finish(), nullptr);
+    EXPECT_TRUE(small.failed());
+}
+
+// Test OSC 1337 places image at the cursor, and moves the cursor past it
+TEST(InlineImageTest, PlacedByOsc)
+{
+    AnsiLogic logic(80, 24);
+    logic.set_cell_size(8, 16);
+    std::string payload = base64_encode(make_bmp(40, 40));
+    std::string seq     = "ab\033]1337;File=name=eA==;size=1;inline=1:" + payload + "\007";
+    for (size_t i = 0; i < seq.size(); i += 100) {
+        logic.process_input(&seq[i], std::min<size_t>(100, seq.size() - i));
+    }
+    ASSERT_EQ(logic.get_images().size(), 1u);
+    ImagePlacement placed = logic.get_images()[0];
+    EXPECT_EQ(placed.line, logic.screen_line(0));
+    EXPECT_EQ(placed.col, 2);
+    EXPECT_EQ(placed.cols, 5);
+    EXPECT_EQ(placed.rows, 3);
+    EXPECT_EQ(logic.get_cursor().row, 2);
+    EXPECT_EQ(logic.get_cursor().col, 7);
+
+    // Same contents share pixels; size in cells keeps aspect ratio.
+    seq = "\r\n\033]1337;File=inline=1;width=10:" + payload + "\033\\";
+    logic.process_input(seq.data(), seq.size());
+    ASSERT_EQ(logic.get_images().size(), 2u);
+    EXPECT_EQ(logic.get_images()[1].image, placed.image);
+    EXPECT_EQ(logic.get_images()[1].cols, 10);
+    EXPECT_EQ(logic.get_images()[1].rows, 5);
+
+    // Not inline: skipped
+    seq = "\033]1337;File=name=eA==:" + payload + "\007x";
+    logic.process_input(seq.data(), seq.size());
+    EXPECT_EQ(logic.get_images().size(), 2u);
+    EXPECT_EQ((*logic.get_line(logic.screen_line(logic.get_cursor().row)))[10].ch, L'x');
+}
+
+// Test memory of images is counted once per image, and released when they scroll away
+TEST(InlineImageTest, MemoryOfImages)
+{
+    AnsiLogic logic(80, 24);
+    std::string payload = base64_encode(make_bmp(40, 40));
+    std::string seq     = "\033]1337;File=inline=1:" + payload + "\007";
+    EXPECT_EQ(logic.image_memory_in_use(), 0u);
+    logic.process_input(seq.data(), seq.size());
+    logic.process_input(seq.data(), seq.size());
+    ASSERT_EQ(logic.get_images().size(), 2u);
+    size_t bytes = logic.image_memory_in_use();
+    EXPECT_GE(bytes, 40u * 40 * 4);
+    EXPECT_LT(bytes, 2u * 40 * 40 * 4);
+
+    // Images on the screen are kept.
+    EXPECT_EQ(logic.drop_images(1), 0u);
+    std::string text(30, '\n');
+    logic.process_input(text.data(), text.size());
+    EXPECT_EQ(logic.drop_images(1), bytes);
+    EXPECT_TRUE(logic.get_images().empty());
+    EXPECT_EQ(logic.image_memory_in_use(), 0u);
+}
+
+// Test URLs and paths are found in text, without trailing punctuation
+TEST(LinkDetectorTest, ScanFindsUrlsAndPaths)
+{
+    auto matches = LinkDetector::scan(
+        L"see https://example.com/a_(b), www.gnu.org. and/or ~/src/x.cpp: /usr/bin ok ://");
+    ASSERT_EQ(matches.size(), 4u);
+    EXPECT_EQ(matches[0].target, "https://example.com/a_(b)");
+    EXPECT_EQ(matches[0].start, 4u);
+    EXPECT_EQ(matches[1].target, "http://www.gnu.org");
+    EXPECT_EQ(matches[2].target, "~/src/x.cpp");
+    EXPECT_EQ(matches[3].target, "/usr/bin");
+    EXPECT_EQ(matches[3].end, 72u);
+
+    EXPECT_TRUE(LinkDetector::scan(L"a / b, 3.5 http:// w.x").empty());
+}
+
+// Test links are found across soft-wrapped rows, and only changed rows are scanned
+TEST(LinkDetectorTest, ScansDirtyRowsOnly)
+{
+    AnsiLogic display(20, 5);
+    LinkDetector links;
+    std::string text = "go to http://example.com/long/path\r\nplain text\r\n";
+    display.process_input(text.data(), text.size());
+    links.update(display);
+    EXPECT_EQ(links.get_rows_scanned(), 5u);
+
+    const Link *link = links.find(1, 5);
+    ASSERT_NE(link, nullptr);
+    EXPECT_EQ(link->target, "http://example.com/long/path");
+    EXPECT_EQ(link->row, 0);
+    EXPECT_EQ(link->col, 6);
+    EXPECT_EQ(link->end_row, 1);
+    EXPECT_EQ(link->end_col, 13);
+    ASSERT_NE(links.find(0, 6), nullptr);
+    EXPECT_EQ(links.find(0, 6)->target, link->target);
+    EXPECT_EQ(links.find(1, 14), nullptr);
+    EXPECT_EQ(links.find(2, 0), nullptr);
+
+    // Nothing changed: nothing rescanned.
+    links.update(display);
+    EXPECT_EQ(links.get_rows_scanned(), 5u);
+
+    // Changed row is rescanned, together with the row it's wrapped to.
+    text = "\033[1;7H\033[K";
+    for (int row : display.process_input(text.data(), text.size())) {
+        links.invalidate(row);
+    }
+    links.update(display);
+    EXPECT_EQ(links.get_rows_scanned(), 7u);
+    EXPECT_EQ(links.find(1, 5), nullptr);
+}
+
+// Test all patterns are found at once, including overlapping ones, across calls
+TEST(TriggerEngineTest, MatchesManyPatterns)
+{
+    TriggerEngine triggers;
+    EXPECT_EQ(triggers.add_pattern("error:"), 0);
+    EXPECT_EQ(triggers.add_pattern("FAILED"), 1);
+    EXPECT_EQ(triggers.add_pattern("or"), 2);
+    EXPECT_EQ(triggers.add_pattern("Ошибка"), 3);
+
+    EXPECT_EQ(triggers.feed("all good", 8), -1);
+    EXPECT_EQ(triggers.feed("warning", 7), -1);
+    EXPECT_EQ(triggers.feed("x errr", 6), -1);
+    triggers.reset();
+
+    // Suffix "or" of "error:" is reported first, then the full pattern.
+    std::string text = "main.c:1: err";
+    EXPECT_EQ(triggers.feed(text.data(), text.size()), -1);
+    EXPECT_EQ(triggers.feed("or", 2), 2);
+    EXPECT_EQ(triggers.feed(": x", 3), 0);
+    triggers.reset();
+    text = "test FAIL";
+    EXPECT_EQ(triggers.feed(text.data(), text.size()), -1);
+    triggers.reset();
+    EXPECT_EQ(triggers.feed("ED", 2), -1);
+
+    // Screen rows are matched as UTF-8.
+    AnsiLogic display(20, 3);
+    int matched = -1;
+    display.set_row_handler([&](int64_t, const Line &line, bool wrap) {
+        matched = triggers.feed(line);
+        if (!wrap)
+            triggers.reset();
+    });
+    text = "\xD0\x9E\xD1\x88\xD0\xB8\xD0\xB1\xD0\xBA\xD0\xB0 1\n";
+    display.process_input(text.data(), text.size());
+    EXPECT_EQ(matched, 3);
+}
+
+// Test row handler is called for line feeds and wraps, with absolute line numbers
+TEST_F(AnsiLogicTest, RowHandler)
+{
+    std::vector<std::pair<int64_t, bool>> rows;
+    logic->set_row_handler(
+        [&](int64_t line, const Line &, bool wrap) { rows.push_back({ line, wrap }); });
+
+    std::string text = "one\r\n" + std::string(100, 'x') + "\n" + std::string(30, '\n');
+    logic->process_input(text.data(), text.size());
+    ASSERT_EQ(rows.size(), 33u);
+    EXPECT_EQ(rows[0], std::make_pair(int64_t(0), false));
+    EXPECT_EQ(rows[1], std::make_pair(int64_t(1), true));
+    EXPECT_EQ(rows[2], std::make_pair(int64_t(2), false));
+    EXPECT_EQ(rows[32], std::make_pair(int64_t(32), false));
+}
+
+// Test rectangular area copy, fill and erase, and the device attributes reply
+TEST_F(AnsiLogicTest, RectangularAreas)
+{
+    auto row_text = [this](int row, int count) {
+        std::string text;
+        for (int c = 0; c < count; ++c) {
+            text += static_cast<char>(logic->get_text_buffer()[row][c].ch);
+        }
+        return text;
+    };
+    std::string input = "abcdef\r\nghijkl\r\nmnopqr";
+    logic->process_input(input.data(), input.size());
+
+    // Copy rows 1-2, columns 2-4 one cell right, over themselves.
+    input = "\033[1;2;2;4;1;1;3;1$v";
+    auto dirty = logic->process_input(input.data(), input.size());
+    EXPECT_EQ(row_text(0, 6), "abbcdf");
+    EXPECT_EQ(row_text(1, 6), "ghhijl");
+    EXPECT_EQ(dirty, std::vector<int>({ 0, 1 }));
+
+    // Fill with '*', then erase the middle; protected cells survive selective erase.
+    input = "\033[42;1;2;3;5$x\033[2;3;2;4$z";
+    logic->process_input(input.data(), input.size());
+    EXPECT_EQ(row_text(0, 6), "a****f");
+    EXPECT_EQ(row_text(1, 6), "g*  *l");
+    input = "\033[H\033[1\"qP\033[0\"q\033[1;1;1;2${";
+    logic->process_input(input.data(), input.size());
+    EXPECT_EQ(row_text(0, 6), "P ***f");
+    EXPECT_TRUE(logic->get_text_buffer()[0][0].attr.protect);
+
+    EXPECT_EQ(logic->take_responses(), "");
+    input = "\033[c\033[>c";
+    logic->process_input(input.data(), input.size());
+    EXPECT_EQ(logic->take_responses(), "\033[?64;22;28c");
+    EXPECT_EQ(logic->take_responses(), "");
+}
+
+// Test scrolling regions: top and bottom margins, left and right margins, insert and delete lines
+TEST_F(AnsiLogicTest, ScrollRegions)
+{
+    logic = std::make_unique<AnsiLogic>(6, 5);
+    auto column = [this](int col) {
+        std::string text;
+        for (int r = 0; r < 5; ++r) {
+            text += static_cast<char>(logic->get_text_buffer()[r][col].ch);
+        }
+        return text;
+    };
+    std::string input = "aaaaa\r\nbbbbb\r\nccccc\r\nddddd\r\neeeee";
+    logic->process_input(input.data(), input.size());
+
+    // Region of rows 2-4: line feed at its bottom scrolls it, and nothing goes to history.
+    input = "\033[2;4r\033[4;1H\nX";
+    logic->process_input(input.data(), input.size());
+    EXPECT_EQ(column(1), "acd e");
+    EXPECT_EQ(column(0), "acdXe");
+    EXPECT_EQ(logic->get_history_size(), 0);
+
+    // Reverse index at the top margin scrolls down; IL and DL within the region.
+    input = "\033[2;1H\033M\033[3;1H\033[L";
+    logic->process_input(input.data(), input.size());
+    EXPECT_EQ(column(1), "a  ce");
+    input = "\033[M";
+    logic->process_input(input.data(), input.size());
+    EXPECT_EQ(column(1), "a c e");
+
+    // Left and right margins: only columns 2-3 of the region scroll.
+    input = "\033[r\033[1;1;5;6$z";
+    logic->process_input(input.data(), input.size());
+    for (int r = 0; r < 5; ++r) {
+        input = "\033[" + std::to_string(r + 1) + ";1H" + std::string(5, 'a' + r);
+        logic->process_input(input.data(), input.size());
+    }
+    input = "\033[?69h\033[2;3s\033[2S";
+    logic->process_input(input.data(), input.size());
+    EXPECT_EQ(column(0), "abcde");
+    EXPECT_EQ(column(1), "cde  ");
+    EXPECT_EQ(column(2), "cde  ");
+    EXPECT_EQ(column(3), "abcde");
+}
+
+// Test text wraps at left and right margins (DECSLRM), and scrolls only inside them
+TEST_F(AnsiLogicTest, WrapInsideMargins)
+{
+    logic = std::make_unique<AnsiLogic>(8, 4);
+    auto row = [this](int r) {
+        std::string text;
+        for (const auto &c : logic->get_text_buffer()[r]) {
+            text += static_cast<char>(c.ch);
+        }
+        return text;
+    };
+    std::string input = "\033[46;1;1;4;8$x\033[?69h\033[3;5s\033[1;3Habcdefgh";
+    logic->process_input(input.data(), input.size());
+    EXPECT_EQ(row(0), "..abc...");
+    EXPECT_EQ(row(1), "..def...");
+    EXPECT_EQ(row(2), "..gh....");
+    EXPECT_EQ(logic->get_cursor().col, 4);
+
+    // Carriage return goes to the left margin; wrap at the bottom scrolls the margins only.
+    input = "\r";
+    logic->process_input(input.data(), input.size());
+    EXPECT_EQ(logic->get_cursor().col, 2);
+    input = "\033[4;3Hxyz12";
+    logic->process_input(input.data(), input.size());
+    EXPECT_EQ(row(0), "..def...");
+    EXPECT_EQ(row(1), "..gh....");
+    EXPECT_EQ(row(2), "..xyz...");
+    EXPECT_EQ(row(3), "..12 ...");
+    EXPECT_FALSE(logic->is_wrapped(2));
+
+    // Outside the margins, line feed at the bottom doesn't scroll.
+    input = "\033[4;1H\nZ";
+    logic->process_input(input.data(), input.size());
+    EXPECT_EQ(row(2), "..xyz...");
+    EXPECT_EQ(row(3), "Z.12 ...");
+
+    // Text from the left of the margins wraps at the right margin, once it gets there.
+    input = "\033[2;1HABCDE";
+    logic->process_input(input.data(), input.size());
+    EXPECT_EQ(row(1), "ABCDE...");
+    EXPECT_EQ(logic->get_cursor().row, 2);
+    EXPECT_EQ(logic->get_cursor().col, 2);
+}
+
+// Test ICH, DCH and ECH stop at the right margin when the cursor is between the margins
+TEST_F(AnsiLogicTest, EditInsideMargins)
+{
+    logic = std::make_unique<AnsiLogic>(8, 2);
+    auto row = [this]() {
+        std::string text;
+        for (const auto &c : logic->get_text_buffer()[0]) {
+            text += static_cast<char>(c.ch);
+        }
+        return text;
+    };
+    std::string input = "ABCDEFGH\033[?69h\033[3;5s\033[1;4H\033[@";
+    logic->process_input(input.data(), input.size());
+    EXPECT_EQ(row(), "ABC DFGH");
+    input = "\033[P";
+    logic->process_input(input.data(), input.size());
+    EXPECT_EQ(row(), "ABCD FGH");
+    input = "\033[1;3H\033[5X";
+    logic->process_input(input.data(), input.size());
+    EXPECT_EQ(row(), "AB   FGH");
+
+    // Outside the margins, the whole rest of the row is edited.
+    input = "\033[1;7H\033[P";
+    logic->process_input(input.data(), input.size());
+    EXPECT_EQ(row(), "AB   FH ");
+}
+
+// Test scroll damage: moved rows are reported as scrolls, not as changed rows
+TEST_F(AnsiLogicTest, ScrollDamage)
+{
+    logic = std::make_unique<AnsiLogic>(10, 4);
+    logic->set_scroll_damage(true);
+    std::string input = "1\r\n2\r\n3\r\n4";
+    logic->process_input(input.data(), input.size());
+    EXPECT_TRUE(logic->take_scrolls().empty());
+
+    // Row 2 changed before two scrolls: it's reported at its new place.
+    input = "\033[3;1Hx\033[4;1H\n\n5";
+    auto dirty  = logic->process_input(input.data(), input.size());
+    auto scroll = logic->take_scrolls();
+    ASSERT_EQ(scroll.size(), 1u);
+    EXPECT_EQ(scroll[0].top, 0);
+    EXPECT_EQ(scroll[0].bottom, 3);
+    EXPECT_EQ(scroll[0].right, 9);
+    EXPECT_EQ(scroll[0].count, 2);
+    EXPECT_EQ(dirty, std::vector<int>({ 0, 2, 3 }));
+    EXPECT_EQ(logic->get_history_size(), 2);
+
+    // Region of partial width: its rows are changed.
+    input = "\033[?69h\033[3;5s\033[T";
+    dirty  = logic->process_input(input.data(), input.size());
+    scroll = logic->take_scrolls();
+    ASSERT_EQ(scroll.size(), 1u);
+    EXPECT_EQ(scroll[0].left, 2);
+    EXPECT_EQ(scroll[0].count, -1);
+    EXPECT_EQ(dirty, std::vector<int>({ 0, 1, 2, 3 }));
+}
+
+// Test sequences listed in the terminfo entry: REP, ECH, ICH, DCH, HPA, VPA and DSR
+TEST_F(AnsiLogicTest, TerminfoSequences)
+{
+    auto row_text = [this](int row, int count) {
+        std::string text;
+        for (int c = 0; c < count; ++c) {
+            text += static_cast<char>(logic->get_text_buffer()[row][c].ch);
+        }
+        return text;
+    };
+    std::string input = "ab\033[3bcdefgh";
+    logic->process_input(input.data(), input.size());
+    EXPECT_EQ(row_text(0, 10), "abbbbcdefg");
+
+    input = "\033[3G\033[2X\033[7G\033[2P\033[1G\033[@";
+    logic->process_input(input.data(), input.size());
+    EXPECT_EQ(row_text(0, 10), " ab  bcfgh");
+
+    input = "\033[5d\033[12G\033[6n";
+    logic->process_input(input.data(), input.size());
+    EXPECT_EQ(logic->get_cursor().row, 4);
+    EXPECT_EQ(logic->get_cursor().col, 11);
+    EXPECT_EQ(logic->take_responses(), "\033[5;12R");
+}
+
+// Test saved cursor and rendition (DECSC/DECRC, SCOSC/SCORC), and pushed renditions (XTPUSHSGR)
+TEST_F(AnsiLogicTest, SaveRestoreState)
+{
+    const auto &screen = logic->get_text_buffer();
+
+    // Reference renditions in the last row
+    std::string input = "\033[24;1H\033[32;44mr\033[33;42ms\033[31;41mt\033[0m";
+    logic->process_input(input.data(), input.size());
+    const CharAttr &green_blue   = screen[23][0].attr;
+    const CharAttr &yellow_green = screen[23][1].attr;
+    const CharAttr &red_red      = screen[23][2].attr;
+
+    // Restore without save goes home with default rendition
+    input = "\033[3;4H\033[31m\0338a";
+    logic->process_input(input.data(), input.size());
+    EXPECT_EQ(screen[0][0].ch, L'a');
+    EXPECT_EQ(screen[0][0].attr, CharAttr());
+
+    input = "\033[2;3H\033[32;44m\0337\033[0m\033[10;10Hx\0338b";
+    logic->process_input(input.data(), input.size());
+    EXPECT_EQ(screen[1][2].ch, L'b');
+    EXPECT_EQ(screen[1][2].attr, green_blue);
+
+    // SCOSC/SCORC share the slot with DECSC/DECRC
+    input = "\033[5;6H\033[0m\033[s\033[33m\033[1;1H\0338c";
+    logic->process_input(input.data(), input.size());
+    EXPECT_EQ(screen[4][5].ch, L'c');
+    EXPECT_EQ(screen[4][5].attr, CharAttr());
+
+    // Push all, then only background; pop restores what was selected
+    input = "\033[31;41m\033[#{\033[32;42m\033[31#{\033[33;43m\033[#}d\033[#}e\033[#}f";
+    logic->process_input(input.data(), input.size());
+    EXPECT_EQ(screen[4][6].attr, yellow_green);
+    EXPECT_EQ(screen[4][7].attr, red_red);
+    EXPECT_EQ(screen[4][8].attr, red_red);
+}
+
+// Test tab stops: defaults, HTS, TBC, CHT and CBT, and stops of columns added by resize
+TEST_F(AnsiLogicTest, TabStops)
+{
+    auto tab_from = [this](int col, const char *seq) {
+        std::string input = "\033[1;" + std::to_string(col + 1) + "H" + seq;
+        logic->process_input(input.data(), input.size());
+        return logic->get_cursor().col;
+    };
+    EXPECT_EQ(tab_from(0, "\t"), 8);
+    EXPECT_EQ(tab_from(8, "\t"), 16);
+    EXPECT_EQ(tab_from(75, "\t"), 79);
+    EXPECT_EQ(tab_from(0, "\033[3I"), 24);
+    EXPECT_EQ(tab_from(20, "\033[2Z"), 8);
+    EXPECT_EQ(tab_from(20, "\033[9Z"), 0);
+
+    // Custom stops across a word of the bitset
+    std::string input = "\033[3g\033[1;6H\033H\033[1;71H\033H\033[1;66H\033H\033[1;67H\033[0g";
+    logic->process_input(input.data(), input.size());
+    EXPECT_EQ(tab_from(0, "\t"), 5);
+    EXPECT_EQ(tab_from(5, "\t"), 65);
+    EXPECT_EQ(tab_from(65, "\t"), 70);
+    EXPECT_EQ(tab_from(70, "\033[Z"), 65);
+    EXPECT_EQ(tab_from(64, "\033[Z"), 5);
+
+    // New columns get default stops; existing ones are kept
+    logic->resize(100, 24);
+    EXPECT_EQ(tab_from(70, "\t"), 80);
+    EXPECT_EQ(tab_from(0, "\t"), 5);
+
+    // Reset restores default stops
+    input = "\033c";
+    logic->process_input(input.data(), input.size());
+    EXPECT_EQ(tab_from(0, "\t"), 8);
+}
+
+// Test PNG checksums and file structure
+TEST(PngWriterTest, EncodesChunks)
+{
+    auto bytes = [](const char *s) { return reinterpret_cast<const uint8_t *>(s); };
+    EXPECT_EQ(png_crc32(bytes("123456789"), 9), 0xCBF43926u);
+    EXPECT_EQ(png_adler32(bytes("Wikipedia"), 9), 0x11E60398u);
+
+    std::vector<uint8_t> pixels(5 * 3 * 4, 0x80);
+    std::string png = encode_png(pixels.data(), 5, 4, 5 * 3);
+    ASSERT_GT(png.size(), 8u + 25 + 12 + 12);
+    EXPECT_EQ(png.substr(0, 8), std::string("\x89PNG\r\n\x1a\n"));
+
+    // Walk chunks and check their CRCs.
+    std::vector<std::string> types;
+    for (size_t pos = 8; pos + 12 <= png.size();) {
+        auto get32 = [&](size_t at) {
+            return uint32_t(uint8_t(png[at])) << 24 | uint32_t(uint8_t(png[at + 1])) << 16 |
+                   uint32_t(uint8_t(png[at + 2])) << 8 | uint8_t(png[at + 3]);
+        };
+        uint32_t length = get32(pos);
+        ASSERT_LE(pos + 12 + length, png.size());
+        types.push_back(png.substr(pos + 4, 4));
+        EXPECT_EQ(png_crc32(bytes(&png[pos + 4]), length + 4), get32(pos + 8 + length));
+        if (types.back() == "IHDR") {
+            EXPECT_EQ(get32(pos + 8), 5u);
+            EXPECT_EQ(get32(pos + 12), 4u);
+        }
+        pos += 12 + length;
+    }
+    EXPECT_EQ(types, (std::vector<std::string>{ "IHDR", "IDAT", "IEND" }));
+}
+
+// Test layouts of tmux windows
+TEST(TmuxControlTest, ParsesLayout)
+{
+    std::vector<PaneGeometry> panes;
+    ASSERT_TRUE(TmuxControl::parse_layout("b25d,80x24,0,0,0", panes));
+    ASSERT_EQ(panes.size(), 1u);
+    EXPECT_EQ(panes[0].id, 0);
+    EXPECT_EQ(panes[0].width, 80);
+
+    // Left pane, and right column split in two
+    ASSERT_TRUE(TmuxControl::parse_layout(
+        "c0d1,80x24,0,0{40x24,0,0,1,39x24,41,0[39x12,41,0,2,39x11,41,13,3]}", panes));
+    ASSERT_EQ(panes.size(), 3u);
+    EXPECT_EQ(panes[1].id, 2);
+    EXPECT_EQ(panes[2].id, 3);
+    EXPECT_EQ(panes[2].x, 41);
+    EXPECT_EQ(panes[2].y, 13);
+    EXPECT_EQ(panes[2].height, 11);
+
+    EXPECT_FALSE(TmuxControl::parse_layout("c0d1,80x24,0,0{40x24,0,0,1", panes));
+    EXPECT_FALSE(TmuxControl::parse_layout("80x24", panes));
+    EXPECT_EQ(TmuxControl::unescape("a\\033[Hb\\134\\15\\"), "a\033[Hb\\\\15\\");
+
+    // Start sequence split by a read
+    EXPECT_EQ(TmuxControl::start_prefix_length("ls\r\n\033P10"), 4u);
+    EXPECT_EQ(TmuxControl::start_prefix_length("\033"), 1u);
+    EXPECT_EQ(TmuxControl::start_prefix_length("\033P1000"), 6u);
+    EXPECT_EQ(TmuxControl::start_prefix_length("\033P2"), 0u);
+    EXPECT_EQ(TmuxControl::start_prefix_length(""), 0u);
+}
+
+// Test notifications of tmux control mode: output goes to panes
+TEST(TmuxControlTest, ParsesNotifications)
+{
+    TmuxControl tmux;
+    std::vector<int> dirty;
+    std::string text = "%begin 1 2 0\r\n%output %9 ignored\r\n%end 1 2 0\r\n"
+                       "%layout-change @1 c0d1,20x5,0,0{10x5,0,0,1,9x5,11,0,2} c0d1,20x5,0,0 *\n"
+                       "%output %1 left\\015\\012pane\n"
+                       "%outp";
+    EXPECT_EQ(tmux.process_input(text.data(), text.size(), dirty), text.size());
+    EXPECT_TRUE(tmux.is_active());
+    EXPECT_FALSE(tmux.in_block);
+    EXPECT_EQ(tmux.get_visible_panes().size(), 2u);
+    EXPECT_EQ(tmux.get_active_pane(), 1);
+
+    // Line continues in next input.
+    dirty.clear();
+    text = "ut %2 right\n%window-pane-changed @1 %2\n";
+    tmux.process_input(text.data(), text.size(), dirty);
+    EXPECT_EQ(dirty, std::vector<int>{ 0 });
+    EXPECT_EQ(tmux.get_active_pane(), 2);
+
+    Line row = tmux.compose_row(0, 20);
+    EXPECT_EQ(row[0].ch, L'l');
+    EXPECT_EQ(row[10].ch, L'│');
+    EXPECT_EQ(row[11].ch, L'r');
+    EXPECT_EQ(tmux.compose_row(1, 20)[0].ch, L'p');
+
+    Cursor cursor;
+    ASSERT_TRUE(tmux.get_cursor(cursor));
+    EXPECT_EQ(cursor.row, 0);
+    EXPECT_EQ(cursor.col, 16);
+
+    // Exit: the rest belongs to the terminal.
+    text = "%exit\n\033\\$ ";
+    EXPECT_EQ(tmux.process_input(text.data(), text.size(), dirty), text.size() - 2);
+    EXPECT_FALSE(tmux.is_active());
+
+    EXPECT_EQ(TmuxControl::send_keys(2, "ls\r"), "send-keys -t %2 -H 6c 73 0d\n");
+}
+
+// Test history of panes is counted by memory governor while they exist
+TEST(TmuxControlTest, PanesUseMemoryBudget)
+{
+    auto &governor = MemoryGovernor::instance();
+    size_t clients = governor.get_stats().clients;
+    {
+        TmuxControl tmux;
+        std::vector<int> dirty;
+        std::string text = "%layout-change @1 c0d1,20x5,0,0{10x5,0,0,1,9x5,11,0,2} x *\n";
+        tmux.process_input(text.data(), text.size(), dirty);
+        EXPECT_EQ(governor.get_stats().clients, clients + 2);
+
+        text = "%layout-change @1 c0d1,20x5,0,0,1 x *\n";
+        tmux.process_input(text.data(), text.size(), dirty);
+        EXPECT_EQ(governor.get_stats().clients, clients + 1);
+    }
+    EXPECT_EQ(governor.get_stats().clients, clients);
+}
+
+// Test timing of cursor blink, bell, frames and resize on a virtual clock
+TEST(FrameSchedulerTest, VirtualTime)
+{
+    VirtualClock clock;
+    FrameScheduler scheduler(clock);
+
+    // Cursor stays visible while typing, then blinks.
+    EXPECT_TRUE(scheduler.is_cursor_visible());
+    clock.advance(400);
+    scheduler.activity();
+    clock.advance(400);
+    EXPECT_FALSE(scheduler.update_blink());
+    clock.advance(100);
+    EXPECT_FALSE(scheduler.update_blink());
+    clock.advance(500);
+    EXPECT_TRUE(scheduler.update_blink());
+    EXPECT_FALSE(scheduler.is_cursor_visible());
+    scheduler.activity();
+    EXPECT_TRUE(scheduler.update_blink());
+    EXPECT_TRUE(scheduler.is_cursor_visible());
+
+    // Frames are coalesced.
+    EXPECT_TRUE(scheduler.can_present());
+    scheduler.frame_presented();
+    clock.advance(FrameScheduler::frame_interval - 1);
+    EXPECT_FALSE(scheduler.can_present());
+    clock.advance(1);
+    EXPECT_TRUE(scheduler.can_present());
+
+    // Bell flashes, and repeated bells are ignored.
+    EXPECT_TRUE(scheduler.ring_bell());
+    EXPECT_TRUE(scheduler.is_bell_visible());
+    EXPECT_FALSE(scheduler.ring_bell());
+    clock.advance(FrameScheduler::bell_flash_duration);
+    EXPECT_TRUE(scheduler.update_bell());
+    EXPECT_FALSE(scheduler.is_bell_visible());
+    EXPECT_FALSE(scheduler.ring_bell());
+    clock.advance(FrameScheduler::bell_cooldown);
+    EXPECT_TRUE(scheduler.ring_bell());
+
+    // Only the last size is taken, when the window stops changing.
+    int cols = 0, rows = 0;
+    scheduler.request_resize(100, 30);
+    clock.advance(50);
+    scheduler.request_resize(120, 40);
+    clock.advance(FrameScheduler::resize_delay - 1);
+    EXPECT_FALSE(scheduler.take_resize(cols, rows));
+    clock.advance(1);
+    EXPECT_TRUE(scheduler.take_resize(cols, rows));
+    EXPECT_EQ(cols, 120);
+    EXPECT_EQ(rows, 40);
+    EXPECT_FALSE(scheduler.take_resize(cols, rows));
+
+    // Parsing slice and idle time.
+    scheduler.start_slice();
+    EXPECT_FALSE(scheduler.slice_expired());
+    clock.advance(FrameScheduler::parse_slice);
+    EXPECT_TRUE(scheduler.slice_expired());
+    EXPECT_FALSE(scheduler.is_idle());
+    clock.advance(FrameScheduler::idle_trim_delay);
+    EXPECT_TRUE(scheduler.is_idle());
+}
+
+// Test that echo of a key is presented without waiting for the frame interval
+TEST(FrameSchedulerTest, InputPresentsAtOnce)
+{
+    VirtualClock clock;
+    FrameScheduler scheduler(clock);
+
+    scheduler.frame_presented();
+    clock.advance(1);
+    EXPECT_FALSE(scheduler.can_present());
+    scheduler.key_pressed();
+    EXPECT_TRUE(scheduler.is_input_pending());
+    EXPECT_TRUE(scheduler.can_present());
+
+    // Output after the echo is coalesced again.
+    scheduler.frame_presented();
+    EXPECT_FALSE(scheduler.is_input_pending());
+    clock.advance(1);
+    EXPECT_FALSE(scheduler.can_present());
+}
+
+// Test local echo: predictions are confirmed by echo, or rolled back
+TEST(LocalEchoTest, ConfirmAndRollback)
+{
+    VirtualClock clock;
+    LocalEcho echo(clock);
+    AnsiLogic logic(20, 5);
+    logic.process_input("$ ", 2);
+
+    // Slow echo: adaptive mode starts to show predictions.
+    EXPECT_FALSE(echo.key_typed(L'l', logic));
+    EXPECT_FALSE(echo.key_typed(L's', logic));
+    ASSERT_EQ(echo.get_predictions().size(), 2u);
+    EXPECT_EQ(echo.get_predictions()[1].col, 3);
+    clock.advance(100);
+    logic.process_input("l", 1);
+    echo.validate(logic);
+    EXPECT_EQ(echo.get_predictions().size(), 1u);
+    EXPECT_EQ(echo.get_latency(), 100u);
+    EXPECT_TRUE(echo.is_visible());
+    logic.process_input("s", 1);
+    EXPECT_TRUE(echo.validate(logic));
+    EXPECT_TRUE(echo.get_predictions().empty());
+
+    // Wrong guess: rolled back, and hidden until confirmed again.
+    EXPECT_TRUE(echo.key_typed(L'x', logic));
+    logic.process_input("\r\n", 2);
+    EXPECT_TRUE(echo.validate(logic));
+    EXPECT_TRUE(echo.get_predictions().empty());
+    EXPECT_EQ(echo.get_mispredictions(), 1u);
+    EXPECT_FALSE(echo.is_visible());
+
+    // Other keys: nothing is predicted until output arrives.
+    echo.key_other();
+    EXPECT_FALSE(echo.key_typed(L'a', logic));
+    EXPECT_TRUE(echo.get_predictions().empty());
+    logic.process_input("$ ", 2);
+    echo.validate(logic);
+    echo.key_typed(L'a', logic);
+    EXPECT_EQ(echo.get_predictions().size(), 1u);
+}
+
+// Test reflow on resize: logical lines are joined and split for the new width
+TEST(ReflowTest, RewrapsLines)
+{
+    AnsiLogic logic(10, 3);
+    std::string text = "\033]133;A\7abcdefghijKLM\r\nxy";
+    logic.process_input(text.data(), text.size());
+    EXPECT_TRUE(logic.is_wrapped(0));
+
+    auto row_text = [&](int64_t line) {
+        std::wstring s;
+        for (const auto &c : *logic.get_line(line)) {
+            s += c.ch;
+        }
+        return s;
+    };
+
+    // Wider: wrapped rows are joined.
+    logic.resize(20, 3);
+    EXPECT_EQ(row_text(0), L"abcdefghijKLM       ");
+    EXPECT_FALSE(logic.is_wrapped(0));
+    EXPECT_EQ(logic.get_cursor().row, 1);
+    EXPECT_EQ(logic.get_cursor().col, 2);
+
+    // Narrower: top row goes to history, cursor stays after the text.
+    logic.resize(5, 3);
+    EXPECT_EQ(logic.first_line(), 0);
+    EXPECT_EQ(logic.screen_line(0), 1);
+    EXPECT_EQ(row_text(0), L"abcde");
+    EXPECT_EQ(row_text(1), L"fghij");
+    EXPECT_EQ(row_text(2), L"KLM  ");
+    EXPECT_EQ(row_text(3), L"xy   ");
+    EXPECT_TRUE(logic.is_wrapped(0));
+    EXPECT_FALSE(logic.is_wrapped(1));
+    EXPECT_EQ(logic.get_cursor().row, 2);
+    EXPECT_EQ(logic.get_cursor().col, 2);
+    EXPECT_EQ(logic.find_prompt(3, false), 0);
+    EXPECT_EQ(logic.reflowed_line(1), 3);
+}
+
+// Test reflow keeps background color of blanks after the text
+TEST(ReflowTest, KeepsBackground)
+{
+    AnsiLogic logic(10, 3);
+    std::string text = "\033[44mabcdefghijkl\033[K\033[m\r\n";
+    logic.process_input(text.data(), text.size());
+    logic.resize(20, 3);
+    const Line &row = *logic.get_line(logic.screen_line(0));
+    EXPECT_EQ(row[11].ch, L'l');
+    EXPECT_EQ(row[19].ch, L' ');
+    EXPECT_EQ(row[19].attr.bg, row[0].attr.bg);
+    EXPECT_FALSE(row[19].attr.bg == CharAttr().bg);
+}
+
+// Test resize of height: rows and their wrap flags move to history and back
+TEST(ReflowTest, ResizeHeight)
+{
+    AnsiLogic logic(10, 5);
+    std::string text = "x\r\nabcdefghijKLM";
+    logic.process_input(text.data(), text.size());
+    EXPECT_TRUE(logic.is_wrapped(1));
+
+    logic.resize(10, 4);
+    EXPECT_TRUE(logic.is_wrapped(1));
+    EXPECT_EQ(logic.get_cursor().row, 2);
+
+    // Shorter than the text: top row goes to history.
+    logic.resize(10, 2);
+    EXPECT_EQ(logic.get_history_size(), 1);
+    EXPECT_EQ(logic.get_text_buffer()[0][0].ch, L'a');
+    EXPECT_TRUE(logic.is_wrapped(0));
+    EXPECT_EQ(logic.get_cursor().row, 1);
+    EXPECT_EQ(logic.get_cursor().col, 3);
+
+    // Taller: it comes back.
+    logic.resize(10, 5);
+    EXPECT_EQ(logic.get_history_size(), 0);
+    EXPECT_EQ(logic.get_text_buffer()[0][0].ch, L'x');
+    EXPECT_FALSE(logic.is_wrapped(0));
+    EXPECT_TRUE(logic.is_wrapped(1));
+    EXPECT_EQ(logic.get_cursor().row, 2);
+    EXPECT_EQ(logic.screen_line(2), 2);
+}
+
+// Test reflow with shell marks of lines already dropped from history
+TEST(ReflowTest, MarksAboveHistory)
+{
+    AnsiLogic logic(20, 5);
+    logic.set_history_limit(10);
+    std::string text;
+    for (int n = 0; n < 10; ++n) {
+        text += "\033]133;A\7$ line\r\n";
+    }
+    text += "a\r\nb\r\nc\r\nd\r\ne\r\nf\r\n\033]133;A\7$ ";
+    logic.process_input(text.data(), text.size());
+    logic.resize(30, 5);
+    int64_t prompt = logic.screen_line(logic.get_cursor().row);
+    EXPECT_EQ(logic.find_prompt(prompt + 1, false), prompt);
+    EXPECT_EQ(logic.find_prompt(logic.first_line() - 1, true), logic.first_line());
+}
+
+// Test reflow of large history, built by worker threads in background
+TEST(ReflowTest, LargeHistory)
+{
+    const int count = 5 * ReflowIndex::min_chunk;
+    AnsiLogic logic(80, 24);
+    logic.set_history_limit(3 * count);
+    std::string text = "\033]133;A\7";
+    for (int n = 0; n < count; ++n) {
+        char line[16];
+        std::snprintf(line, sizeof(line), "%05d\r\n", n);
+        text += line;
+    }
+    logic.process_input(text.data(), text.size());
+    logic.resize(3, 24);
+
+    // Screen is ready, and history is still being built.
+    EXPECT_TRUE(logic.is_reflow_pending());
+    EXPECT_EQ(logic.get_text_buffer()[22][0].ch, L'7');
+    EXPECT_EQ(logic.get_cursor().row, 23);
+
+    // Every line takes two rows now, plus the line with the cursor.
+    EXPECT_EQ(logic.get_history_size(), 2 * count + 1 - 24);
+    EXPECT_EQ(logic.find_prompt(logic.first_line() + 1, false), logic.first_line());
+    for (int n = 0; n < count; n += 997) {
+        char line[16];
+        std::snprintf(line, sizeof(line), "%05d ", n);
+        int64_t row = logic.reflowed_line(n);
+        ASSERT_EQ(row - logic.first_line(), 2 * n);
+        EXPECT_EQ((*logic.get_line(row))[0].ch, line[0]);
+        EXPECT_EQ((*logic.get_line(row))[2].ch, line[2]);
+        EXPECT_EQ((*logic.get_line(row + 1))[1].ch, line[4]);
+    }
+
+    // Lines scrolled meanwhile go after reflowed ones: "more" takes two rows.
+    text = "more\r\n";
+    logic.process_input(text.data(), text.size());
+    logic.set_history_limit(3 * count);
+    EXPECT_FALSE(logic.is_reflow_pending());
+    EXPECT_EQ(logic.get_history_size(), 2 * count + 3 - 24);
+}
+
+// Test benchmark output: same on every run, redraws fill the screen
+TEST(BenchCorpusTest, Workloads)
+{
+    EXPECT_EQ(gen_ascii(10000), gen_ascii(10000));
+    EXPECT_GE(gen_colors(10000).size(), 10000u);
+
+    AnsiLogic logic(80, 24);
+    std::string redraw = gen_redraw(10000);
+    logic.process_input(redraw.data(), redraw.size());
+    const Line *top = logic.get_line(logic.screen_line(0));
+    ASSERT_NE(top, nullptr);
+    EXPECT_NE(std::count_if(top->begin(), top->end(), [](const Char &c) { return c.ch != L' '; }),
+              0);
+}
+
+// Test output queue: chunks are released when due, and the queue reports when it's full
+TEST(OutputQueueTest, BoundedAndDue)
+{
+    OutputQueue queue(8);
+    std::string data;
+    queue.push("abcd", 4, 100);
+    EXPECT_FALSE(queue.is_full());
+    queue.push("efgh", 4, 200);
+    EXPECT_TRUE(queue.is_full());
+    EXPECT_EQ(queue.get_bytes(), 8u);
+
+    EXPECT_FALSE(queue.pop(99, data));
+    EXPECT_TRUE(queue.pop(150, data));
+    EXPECT_EQ(data, "abcd");
+    EXPECT_FALSE(queue.is_full());
+    EXPECT_FALSE(queue.pop(150, data));
+    EXPECT_TRUE(queue.pop(200, data));
+    EXPECT_EQ(data, "efgh");
+    EXPECT_TRUE(queue.empty());
+    EXPECT_EQ(queue.get_bytes(), 0u);
+}
+
 int main(int argc, char **argv)
 {
     ::testing::InitGoogleTest(&argc, argv);